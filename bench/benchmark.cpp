@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+namespace bench {
+
+uint64_t NowInNsec() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+Runner::Runner(const Config& config) : config_(config) {}
+
+Runner::~Runner() {}
+
+bool Runner::ShouldRun(const std::string& name) const {
+  return name.find(config_.filter) != std::string::npos;
+}
+
+void Runner::Run(const std::string& name,
+                 size_t bytes,
+                 const Function& function) {
+  if (!ShouldRun(name))
+    return;
+
+  // Find the iteration count that runs long enough. It warms up caches too.
+  const uint64_t min_nsec = config_.min_time * 1000000000;
+  size_t iterations = 1;
+  while (true) {
+    uint64_t start = NowInNsec();
+    function(iterations);
+    uint64_t elapsed = NowInNsec() - start;
+    if (elapsed >= min_nsec)
+      break;
+    // Aim a bit over |min_nsec|, but don't grow more than 10x at once.
+    double scale = elapsed ? 1.2 * min_nsec / elapsed : 10;
+    iterations *= std::max(2.0, std::min(10.0, scale));
+  }
+
+  std::vector<double> samples;
+  for (int i = 0; i < config_.repetitions; ++i) {
+    uint64_t start = NowInNsec();
+    function(iterations);
+    samples.push_back(1.0 * (NowInNsec() - start) / iterations);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  Result result;
+  result.name = name;
+  result.unit = "ns/op";
+  result.repetitions = config_.repetitions;
+  result.iterations = iterations;
+  result.median = samples[samples.size() / 2];
+  result.min = samples.front();
+  result.max = samples.back();
+  if (bytes && result.median > 0)
+    result.bytes_per_second = bytes * 1000000000.0 / result.median;
+  AddResult(result);
+}
+
+void Runner::AddResult(const Result& result) {
+  if (result.bytes_per_second > 0) {
+    fprintf(stderr, "%-44s %14.1f %-6s %10.2f GB/s\n", result.name.data(),
+            result.median, result.unit.data(),
+            result.bytes_per_second / 1000000000);
+  } else {
+    fprintf(stderr, "%-44s %14.1f %-6s\n", result.name.data(), result.median,
+            result.unit.data());
+  }
+  results_.push_back(result);
+}
+
+std::string Runner::ToJSON() const {
+  std::string json;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\n  \"format\": \"ged_bench/1\",\n  \"config\": {\"repetitions\": "
+           "%d, \"min_time\": %.3f, \"frame_duration\": %.3f, "
+           "\"render_node\": \"%s\"},\n  \"benchmarks\": [",
+           config_.repetitions, config_.min_time, config_.frame_duration,
+           config_.render_node.data());
+  json += buf;
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const Result& result = results_[i];
+    snprintf(buf, sizeof(buf),
+             "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"repetitions\": "
+             "%d, \"iterations\": %llu, \"median\": %.3f, \"min\": %.3f, "
+             "\"max\": %.3f, \"bytes_per_second\": %.0f, \"details\": ",
+             i ? "," : "", result.name.data(), result.unit.data(),
+             result.repetitions,
+             static_cast<unsigned long long>(result.iterations), result.median,
+             result.min, result.max, result.bytes_per_second);
+    json += buf;
+    json += result.details.empty() ? "null" : result.details;
+    json += "}";
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
+
+}  // namespace bench
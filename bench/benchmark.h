@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_BENCH_BENCHMARK_H_
+#define GED_BENCH_BENCHMARK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/*
+ * Runner measures benchmarks and collects the results into a JSON report,
+ * which keeps the same layout from release to release so that reports can be
+ * diffed.
+ *
+ * A benchmark function runs its body |iterations| times. The runner grows
+ * |iterations| until one call takes at least Config::min_time, then reports
+ * the median of Config::repetitions calls.
+ */
+class Runner {
+ public:
+  struct Config {
+    // runs only the benchmarks whose name contains it
+    std::string filter;
+    int repetitions = 5;
+    // in seconds
+    double min_time = 0.2;
+    // how long each frame benchmark renders, in seconds
+    double frame_duration = 3;
+    // for the GL benchmarks; empty renders without GBM
+    std::string render_node;
+  };
+
+  struct Result {
+    std::string name;
+    // "ns/op" or "fps"
+    std::string unit;
+    int repetitions = 0;
+    uint64_t iterations = 0;
+    double median = 0;
+    double min = 0;
+    double max = 0;
+    // for the median, or 0 if the benchmark doesn't process bytes
+    double bytes_per_second = 0;
+    // a JSON object with more details, or empty
+    std::string details;
+  };
+
+  typedef std::function<void(size_t iterations)> Function;
+
+  explicit Runner(const Config& config);
+  ~Runner();
+  Runner(const Runner&) = delete;
+  void operator=(const Runner&) = delete;
+
+  const Config& GetConfig() const { return config_; }
+  bool ShouldRun(const std::string& name) const;
+
+  // Measures |function| in ns per iteration, which processes |bytes|.
+  void Run(const std::string& name, size_t bytes, const Function& function);
+
+  // Adds a result measured by the caller, e.g. a frame rate.
+  void AddResult(const Result& result);
+
+  std::string ToJSON() const;
+
+ private:
+  const Config config_;
+  std::vector<Result> results_;
+};
+
+// Keeps the compiler from optimizing |value| away.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+uint64_t NowInNsec();
+
+// The suites.
+void RunMatrixBenchmarks(Runner* runner);
+void RunPixelBenchmarks(Runner* runner);
+bool RunStreamTextureBenchmarks(Runner* runner);
+bool RunFrameBenchmarks(Runner* runner);
+
+}  // namespace bench
+
+#endif  // GED_BENCH_BENCHMARK_H_
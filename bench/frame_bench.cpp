@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <memory>
+
+#include "frame_stats.h"
+#include "gbm_es2_demo.h"
+
+namespace bench {
+
+namespace {
+
+struct Scene {
+  const char* name;
+  bool map;
+  bool threaded;
+  size_t num_buffers;
+};
+
+const Scene kScenes[] = {
+    {"frame/cube", false, false, 2},
+    {"frame/cube_threaded", false, true, 3},
+    {"frame/cube_map", true, false, 2},
+    {"frame/cube_map_threaded", true, true, 3},
+};
+
+}  // namespace
+
+// Renders each scene headless and uncapped, so the frame rate is bound only
+// by the CPU and the GPU.
+bool RunFrameBenchmarks(Runner* runner) {
+  const Runner::Config& config = runner->GetConfig();
+  for (const Scene& scene : kScenes) {
+    if (!runner->ShouldRun(scene.name))
+      continue;
+
+    demo::Options options;
+    options.headless = true;
+    options.render_node = config.render_node;
+    options.refresh_rate = 0;
+    options.num_buffers = scene.num_buffers;
+    options.threaded = scene.threaded;
+    options.duration = config.frame_duration;
+    // Runs without a terminal would stop at the EOF of stdin.
+    options.watch_stdin = false;
+
+    std::unique_ptr<demo::ES2Cube> cube;
+    if (scene.map) {
+      cube.reset(new demo::ES2CubeMapImpl());
+    } else {
+      cube.reset(new demo::ES2CubeImpl());
+    }
+    if (!cube->Initialize(options)) {
+      fprintf(stderr, "failed to initialize %s.\n", scene.name);
+      return false;
+    }
+
+    uint64_t start = NowInNsec();
+    if (!cube->Run()) {
+      fprintf(stderr, "failed to run %s.\n", scene.name);
+      return false;
+    }
+    double seconds = (NowInNsec() - start) / 1000000000.0;
+
+    ged::FrameStats* stats = cube->GetFrameStats();
+    Runner::Result result;
+    result.name = scene.name;
+    result.unit = "fps";
+    result.repetitions = 1;
+    result.iterations = stats->GetFlipCount();
+    result.median = result.iterations / seconds;
+    result.min = result.median;
+    result.max = result.median;
+    result.details = stats->ToJSON();
+    runner->AddResult(result);
+  }
+  return true;
+}
+
+}  // namespace bench
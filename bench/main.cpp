@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "benchmark.h"
+
+static const char* shortopts = "F:N:O:R:T:";
+
+static const struct option longopts[] = {
+    {"filter", required_argument, 0, 'F'},
+    {"render-node", required_argument, 0, 'N'},
+    {"output", required_argument, 0, 'O'},
+    {"repetitions", required_argument, 0, 'R'},
+    {"min-time", required_argument, 0, 'T'},
+    {"frame-duration", required_argument, 0, 'D'},
+    {0, 0, 0, 0}};
+
+static void usage(const char* name) {
+  printf(
+      "Usage: %s [-FNORT]\n"
+      "\n"
+      "options:\n"
+      "    -F, --filter=TEXT        run benchmarks whose name contains TEXT\n"
+      "    -N, --render-node=NODE   render on NODE (default none, i.e.\n"
+      "                             surfaceless EGL)\n"
+      "    -O, --output=FILE        write the JSON report to FILE instead of\n"
+      "                             stdout\n"
+      "    -R, --repetitions=N      repeat each benchmark N times (default 5)\n"
+      "    -T, --min-time=SEC       run each repetition at least SEC seconds\n"
+      "                             (default 0.2)\n"
+      "    --frame-duration=SEC     render each frame benchmark SEC seconds\n"
+      "                             (default 3)\n",
+      name);
+}
+
+int main(int argc, char* argv[]) {
+  bench::Runner::Config config;
+  std::string output;
+  int opt;
+
+  while ((opt = getopt_long_only(argc, argv, shortopts, longopts, nullptr)) !=
+         -1) {
+    switch (opt) {
+      case 'D':
+        config.frame_duration = std::strtod(optarg, nullptr);
+        break;
+      case 'F':
+        config.filter = optarg;
+        break;
+      case 'N':
+        config.render_node = optarg;
+        break;
+      case 'O':
+        output = optarg;
+        break;
+      case 'R':
+        config.repetitions = std::atoi(optarg);
+        break;
+      case 'T':
+        config.min_time = std::strtod(optarg, nullptr);
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+  if (config.repetitions < 1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  bench::Runner runner(config);
+  bench::RunMatrixBenchmarks(&runner);
+  bench::RunPixelBenchmarks(&runner);
+  if (!bench::RunStreamTextureBenchmarks(&runner) ||
+      !bench::RunFrameBenchmarks(&runner)) {
+    fprintf(stderr, "something wrong happened.\n");
+    return -1;
+  }
+
+  std::string json = runner.ToJSON();
+  if (output.empty()) {
+    fputs(json.data(), stdout);
+    return 0;
+  }
+  FILE* file = fopen(output.data(), "w");
+  if (!file) {
+    fprintf(stderr, "cannot open '%s': %m\n", output.data());
+    return -1;
+  }
+  fputs(json.data(), file);
+  fclose(file);
+  return 0;
+}
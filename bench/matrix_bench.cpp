@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+namespace bench {
+
+void RunMatrixBenchmarks(Runner* runner) {
+  runner->Run("matrix/multiply", 0, [](size_t iterations) {
+    ged::Matrix a;
+    a.Rotate(30.f, 1.f, 0.f, 0.f);
+    ged::Matrix b;
+    b.Translate(0.f, 0.f, -8.f);
+    for (size_t i = 0; i < iterations; ++i) {
+      a.MatrixMultiply(b);
+      DoNotOptimize(a);
+    }
+  });
+
+  runner->Run("matrix/rotate", 0, [](size_t iterations) {
+    ged::Matrix m;
+    for (size_t i = 0; i < iterations; ++i) {
+      m.Rotate(0.25f * i, 1.f, 1.f, 0.f);
+      DoNotOptimize(m);
+    }
+  });
+
+  runner->Run("matrix/rotate_axis", 0, [](size_t iterations) {
+    ged::Matrix m;
+    for (size_t i = 0; i < iterations; ++i) {
+      m.Rotate<ged::Matrix::Axis::Y>(0.25f * i);
+      DoNotOptimize(m);
+    }
+  });
+
+  // The translation and three rotations of a cube, the old way and fused.
+  runner->Run("matrix/translate_rotate_xyz", 0, [](size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+      ged::Matrix m;
+      m.Translate(0.0f, 0.0f, -8.0f);
+      m.Rotate(45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
+      m.Rotate(45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
+      m.Rotate(10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
+      DoNotOptimize(m);
+    }
+  });
+
+  runner->Run("matrix/from_trs", 0, [](size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+      ged::Matrix m = ged::Matrix::FromTRS(
+          {0.0f, 0.0f, -8.0f},
+          {45.0f + (0.25f * i), 45.0f - (0.5f * i), 10.0f + (0.15f * i)},
+          {1.0f, 1.0f, 1.0f});
+      DoNotOptimize(m);
+    }
+  });
+
+  runner->Run("matrix/normal_matrix", 0, [](size_t iterations) {
+    ged::Matrix m = ged::Matrix::FromTRS({0.f, 0.f, -8.f}, {30.f, 20.f, 10.f},
+                                         {1.f, 2.f, 3.f});
+    float normal[9];
+    for (size_t i = 0; i < iterations; ++i) {
+      m.GetNormalMatrix(normal);
+      DoNotOptimize(normal);
+    }
+  });
+
+  runner->Run("matrix/perspective", 0, [](size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+      ged::Matrix m;
+      m.Perspective(35.f, 1.f + (i & 1), 6.f, 10.f);
+      DoNotOptimize(m);
+    }
+  });
+
+  // One op is a frame of |kObjects| objects, each with its own modelview.
+  const size_t kObjects = 4096;
+  const std::string suffix = "/" + std::to_string(kObjects);
+  std::vector<ged::Matrix> modelviews(kObjects);
+  for (size_t i = 0; i < kObjects; ++i)
+    modelviews[i].Translate(0.f, 0.f, -8.f - i);
+  std::vector<ged::Matrix> mvps(kObjects);
+  const ged::Matrix* raw_modelviews = modelviews.data();
+  ged::Matrix* raw_mvps = mvps.data();
+  runner->Run("matrix/multiply_array" + suffix, 0,
+              [raw_modelviews, raw_mvps, kObjects](size_t iterations) {
+                ged::Matrix projection;
+                projection.Perspective(35.f, 16.f / 9.f, 6.f, 10.f);
+                for (size_t i = 0; i < iterations; ++i) {
+                  ged::Matrix::MultiplyArray(raw_modelviews, projection,
+                                             raw_mvps, kObjects);
+                  DoNotOptimize(raw_mvps);
+                }
+              });
+
+  std::vector<float> vectors(kObjects * 4, 1.f);
+  float* raw_vectors = vectors.data();
+  runner->Run("matrix/transform_vectors" + suffix, 0,
+              [raw_vectors, kObjects](size_t iterations) {
+                ged::Matrix m;
+                m.Rotate(30.f, 1.f, 0.f, 0.f);
+                for (size_t i = 0; i < iterations; ++i) {
+                  m.TransformVectors(raw_vectors, raw_vectors, kObjects);
+                  DoNotOptimize(raw_vectors);
+                }
+              });
+
+  // What ES2CubeImpl::Draw() does every frame.
+  runner->Run("matrix/cube_frame", 0, [](size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+      ged::Matrix modelview = ged::Matrix::FromTRS(
+          {0.0f, 0.0f, -8.0f},
+          {45.0f + (0.25f * i), 45.0f - (0.5f * i), 10.0f + (0.15f * i)},
+          {1.0f, 1.0f, 1.0f});
+
+      ged::Matrix projection;
+      projection.Perspective(35.f, 16.f / 9.f, 6.f, 10.f);
+
+      ged::Matrix modelviewprojection = modelview;
+      modelviewprojection.MatrixMultiply(projection);
+      float normal[9] = {};
+      modelview.GetNormalMatrix(&normal[0]);
+      DoNotOptimize(modelviewprojection);
+      DoNotOptimize(normal);
+    }
+  });
+}
+
+}  // namespace bench
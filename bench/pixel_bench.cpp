@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "pixel_kernels.h"
+
+namespace bench {
+
+namespace {
+
+using ged::pixel::ISA;
+
+const ISA kISAs[] = {ISA::SCALAR, ISA::SSE2, ISA::AVX2, ISA::NEON};
+// Square textures; 256 stays in the cache, 2048 doesn't.
+const size_t kSizes[] = {256, 2048};
+// Padding of the destination rows, like a StreamTexture stride.
+const size_t kStridePadding = 64;
+
+}  // namespace
+
+void RunPixelBenchmarks(Runner* runner) {
+  ISA default_isa = ged::pixel::GetISA();
+  for (ISA isa : kISAs) {
+    if (!ged::pixel::IsSupported(isa))
+      continue;
+    ged::pixel::SetISA(isa);
+
+    for (size_t size : kSizes) {
+      std::string suffix = std::string("/") + ged::pixel::GetISAName(isa) +
+                           "/" + std::to_string(size);
+      const size_t count = size * size;
+      // The throughput counts the bytes written.
+      const size_t bytes = count * sizeof(uint32_t);
+
+      std::vector<uint32_t> src(count);
+      for (size_t i = 0; i < count; ++i)
+        src[i] = i * 2654435761u;
+      std::vector<uint32_t> dst(count);
+      std::vector<uint16_t> src16(count);
+      ged::pixel::ARGBToRGB565(src16.data(), src.data(), count);
+      std::vector<uint16_t> dst16(count);
+      uint32_t* raw_src = src.data();
+      uint32_t* raw_dst = dst.data();
+      uint16_t* raw_src16 = src16.data();
+      uint16_t* raw_dst16 = dst16.data();
+
+      runner->Run("pixel/fill" + suffix, bytes,
+                  [raw_dst, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::Fill(raw_dst, count, i);
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+
+      runner->Run("pixel/stream_fill" + suffix, bytes,
+                  [raw_dst, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::StreamFill(raw_dst, count, i);
+                      ged::pixel::StreamFence();
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+
+      // The check pattern of the map demo.
+      std::vector<uint32_t> pattern(128, 0);
+      std::fill(pattern.begin(), pattern.begin() + 64, 0xffffffff);
+      const uint32_t* raw_pattern = pattern.data();
+      runner->Run("pixel/fill_pattern" + suffix, bytes,
+                  [raw_dst, raw_pattern, size](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      for (size_t y = 0; y < size; ++y) {
+                        ged::pixel::FillPattern(raw_dst + y * size, size,
+                                                raw_pattern, 128, y + i);
+                      }
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+
+      const size_t row_bytes = size * sizeof(uint32_t);
+      const size_t dst_stride = row_bytes + kStridePadding;
+      std::vector<uint8_t> strided(dst_stride * size);
+      uint8_t* raw_strided = strided.data();
+      runner->Run(
+          "pixel/blit" + suffix, bytes,
+          [raw_strided, raw_src, row_bytes, dst_stride,
+           size](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+              ged::pixel::Blit(raw_strided, dst_stride,
+                               reinterpret_cast<const uint8_t*>(raw_src),
+                               row_bytes, row_bytes, size);
+              DoNotOptimize(raw_strided);
+            }
+          });
+
+      runner->Run(
+          "pixel/stream_blit" + suffix, bytes,
+          [raw_strided, raw_src, row_bytes, dst_stride,
+           size](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+              ged::pixel::StreamBlit(raw_strided, dst_stride,
+                                     reinterpret_cast<const uint8_t*>(raw_src),
+                                     row_bytes, row_bytes, size);
+              ged::pixel::StreamFence();
+              DoNotOptimize(raw_strided);
+            }
+          });
+
+      runner->Run("pixel/xrgb_to_argb" + suffix, bytes,
+                  [raw_dst, raw_src, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::XRGBToARGB(raw_dst, raw_src, count);
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+
+      runner->Run("pixel/argb_to_rgb565" + suffix, count * sizeof(uint16_t),
+                  [raw_dst16, raw_src, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::ARGBToRGB565(raw_dst16, raw_src, count);
+                      DoNotOptimize(raw_dst16);
+                    }
+                  });
+
+      runner->Run("pixel/rgb565_to_argb" + suffix, bytes,
+                  [raw_dst, raw_src16, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::RGB565ToARGB(raw_dst, raw_src16, count);
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+
+      runner->Run("pixel/premultiply" + suffix, bytes,
+                  [raw_dst, raw_src, count](size_t iterations) {
+                    for (size_t i = 0; i < iterations; ++i) {
+                      ged::pixel::Premultiply(raw_dst, raw_src, count);
+                      DoNotOptimize(raw_dst);
+                    }
+                  });
+    }
+  }
+  ged::pixel::SetISA(default_isa);
+}
+
+}  // namespace bench
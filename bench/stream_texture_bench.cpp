@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <drm_fourcc.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "drm_modesetter.h"
+#include "egl_drm_glue.h"
+#include "gbm_es2_demo.h"
+#include "pixel_kernels.h"
+#include "tiled_producer.h"
+
+namespace bench {
+
+namespace {
+
+const ged::StreamTexture::Access kWrite = ged::StreamTexture::Access::WRITE;
+const size_t kSizes[] = {256, 512, 1024, 2048};
+const char* kNames[] = {
+    "stream_texture/map_unmap", "stream_texture/map_write_unmap",
+    "check_pattern/fill", "check_pattern/stream_texture",
+    "stream_texture/ring_write_unmap", "check_pattern/tiled",
+    "stream_texture/map_stream_write_unmap", "stream_texture/nv12_write_unmap",
+    "stream_texture/ring_partial_write_unmap",
+};
+const size_t kRingSlots = 3;
+
+}  // namespace
+
+bool RunStreamTextureBenchmarks(Runner* runner) {
+  // Don't bother with GL if everything is filtered out.
+  bool should_run = false;
+  for (size_t size : kSizes) {
+    for (const char* name : kNames) {
+      should_run |=
+          runner->ShouldRun(std::string(name) + "/" + std::to_string(size));
+    }
+  }
+  if (!should_run)
+    return true;
+
+  // Stream textures need a GL context, but nothing is ever flipped.
+  ged::DRMModesetter::HeadlessConfig config;
+  config.render_node = runner->GetConfig().render_node;
+  config.refresh_rate = 0;
+  std::unique_ptr<ged::EGLDRMGlue> egl = ged::EGLDRMGlue::Create(
+      ged::DRMModesetter::CreateHeadless(config),
+      [](GLuint, const ged::FrameTiming&, size_t) {}, 2, false);
+  if (!egl) {
+    fprintf(stderr, "failed to create EGLDRMGlue.\n");
+    return false;
+  }
+  // One thread per core.
+  std::unique_ptr<ged::TiledProducer> producer = ged::TiledProducer::Create(0);
+  if (!producer)
+    return false;
+  ged::TiledProducer* raw_producer = producer.get();
+
+  for (size_t size : kSizes) {
+    std::string suffix = "/" + std::to_string(size);
+    std::unique_ptr<ged::StreamTexture> texture =
+        egl->CreateStreamTexture(size, size);
+    if (!texture) {
+      fprintf(stderr, "failed to create a %zux%zu stream texture.\n", size,
+              size);
+      return false;
+    }
+    ged::StreamTexture::Dimension dimension = texture->GetDimension();
+    size_t bytes = dimension.stride * dimension.height;
+    ged::StreamTexture* raw_texture = texture.get();
+
+    runner->Run(kNames[0] + suffix, 0,
+                [raw_texture](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    DoNotOptimize(raw_texture->Map(kWrite));
+                    raw_texture->Unmap();
+                  }
+                });
+
+    runner->Run(kNames[1] + suffix, bytes,
+                [raw_texture, bytes](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    void* pixels = raw_texture->Map(kWrite);
+                    std::memset(pixels, i, bytes);
+                    raw_texture->Unmap();
+                  }
+                });
+
+    // The same with non-temporal stores.
+    runner->Run(kNames[6] + suffix, bytes,
+                [raw_texture, dimension](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    void* pixels = raw_texture->Map(kWrite);
+                    ged::pixel::StreamFill(static_cast<uint32_t*>(pixels),
+                                           dimension.stride / 4 *
+                                               dimension.height,
+                                           i);
+                    raw_texture->Unmap();
+                  }
+                });
+
+    // The pattern fill alone, into system memory.
+    std::vector<uint8_t> buffer(bytes);
+    uint8_t* raw_buffer = buffer.data();
+    runner->Run(kNames[2] + suffix, bytes,
+                [raw_buffer, dimension](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    demo::FillCheckPattern(raw_buffer, dimension,
+                                           (i % 100) / 100.f, i & 1);
+                    DoNotOptimize(raw_buffer);
+                  }
+                });
+
+    // What ES2CubeMapImpl::UpdateStreamTexture() does every frame.
+    runner->Run(kNames[3] + suffix, bytes,
+                [raw_texture, dimension](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    void* pixels = raw_texture->Map(kWrite);
+                    demo::FillCheckPattern(pixels, dimension,
+                                           (i % 100) / 100.f, i & 1);
+                    raw_texture->Unmap();
+                  }
+                });
+
+    // Same as map_write_unmap, but never waits for the GPU to release the
+    // memory.
+    std::unique_ptr<ged::StreamTexture> ring =
+        egl->CreateStreamTexture(size, size, kRingSlots);
+    if (!ring) {
+      fprintf(stderr, "failed to create a %zux%zu stream texture ring.\n",
+              size, size);
+      return false;
+    }
+    ged::StreamTexture* raw_ring = ring.get();
+    runner->Run(kNames[4] + suffix, bytes,
+                [raw_ring, bytes](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    void* pixels = raw_ring->Map(kWrite);
+                    std::memset(pixels, i, bytes);
+                    raw_ring->Unmap();
+                  }
+                });
+
+    // A sixteenth of it, moving around, so the slots catch up with copies.
+    int tile = size / 4;
+    runner->Run(kNames[8] + suffix, tile * tile * 4,
+                [raw_ring, dimension, tile](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    ged::StreamTexture::Rect rect = {
+                        int(i % 4) * tile, int(i / 4 % 4) * tile, tile, tile};
+                    uint8_t* pixels =
+                        static_cast<uint8_t*>(raw_ring->Map(kWrite, rect));
+                    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                      std::memset(pixels + y * dimension.stride + rect.x * 4,
+                                  i, rect.width * 4);
+                    }
+                    raw_ring->Unmap();
+                  }
+                });
+
+    // check_pattern/stream_texture, on all cores.
+    runner->Run(
+        kNames[5] + suffix, bytes,
+        [raw_producer, raw_texture](size_t iterations) {
+          for (size_t i = 0; i < iterations; ++i) {
+            float progress = (i % 100) / 100.f;
+            bool even_turn = i & 1;
+            raw_producer->Produce(
+                raw_texture, kWrite,
+                [progress, even_turn](const ged::TiledProducer::Tile& tile) {
+                  demo::FillCheckPattern(tile, progress, even_turn);
+                });
+          }
+        });
+
+    // A video frame: the Y plane and the half sized UV plane.
+    if (!egl->IsStreamTextureFormatSupported(DRM_FORMAT_NV12))
+      continue;
+    std::unique_ptr<ged::StreamTexture> nv12 =
+        egl->CreateStreamTexture(size, size, 1, DRM_FORMAT_NV12);
+    if (!nv12) {
+      fprintf(stderr, "failed to create a %zux%zu NV12 stream texture.\n",
+              size, size);
+      return false;
+    }
+    ged::StreamTexture* raw_nv12 = nv12.get();
+    size_t nv12_bytes = 0;
+    for (size_t plane = 0; plane < nv12->GetPlaneCount(); ++plane) {
+      ged::StreamTexture::Dimension plane_dimension =
+          nv12->GetPlaneDimension(plane);
+      nv12_bytes += plane_dimension.stride * plane_dimension.height;
+    }
+    runner->Run(kNames[7] + suffix, nv12_bytes,
+                [raw_nv12](size_t iterations) {
+                  for (size_t i = 0; i < iterations; ++i) {
+                    raw_nv12->Map(kWrite);
+                    for (size_t plane = 0; plane < raw_nv12->GetPlaneCount();
+                         ++plane) {
+                      ged::StreamTexture::Dimension plane_dimension =
+                          raw_nv12->GetPlaneDimension(plane);
+                      std::memset(raw_nv12->GetPlaneData(plane), i,
+                                  plane_dimension.stride *
+                                      plane_dimension.height);
+                    }
+                    raw_nv12->Unmap();
+                  }
+                });
+  }
+  return true;
+}
+
+}  // namespace bench
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A compositor client for testing: it fills a few linear GBM buffers with
+ * the check pattern on the CPU and submits them to gbm_es2_demo -C at the
+ * given rate, writing a buffer again only after it's released.
+ */
+
+#include <fcntl.h>
+#include <gbm.h>
+#include <getopt.h>
+#include <linux/dma-buf.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compositor.h"
+#include "event_loop.h"
+#include "gbm_es2_demo.h"
+
+namespace {
+
+struct Options {
+  std::string socket_path = "/tmp/ged-compositor";
+  std::string render_node = "/dev/dri/renderD128";
+  uint32_t output = 0;
+  int x = 0;
+  int y = 0;
+  int width = 256;
+  int height = 256;
+  int zpos = 1;
+  int rate = 60;
+  size_t num_buffers = 3;
+};
+
+struct Buffer {
+  struct gbm_bo* bo = nullptr;
+  int fd = -1;
+  void* addr = nullptr;
+  ged::StreamTexture::Dimension dimension;
+  // between SUBMIT and RELEASE
+  bool busy = false;
+};
+
+class Client {
+ public:
+  ~Client() {
+    if (socket_fd_ >= 0)
+      close(socket_fd_);
+    for (Buffer& buffer : buffers_) {
+      if (buffer.addr)
+        munmap(buffer.addr, buffer.dimension.stride * buffer.dimension.height);
+      if (buffer.fd >= 0)
+        close(buffer.fd);
+      if (buffer.bo)
+        gbm_bo_destroy(buffer.bo);
+    }
+    if (gbm_)
+      gbm_device_destroy(gbm_);
+    if (drm_fd_ >= 0)
+      close(drm_fd_);
+  }
+
+  bool Initialize(const Options& options) {
+    options_ = options;
+    drm_fd_ = open(options.render_node.c_str(), O_RDWR | O_CLOEXEC);
+    if (drm_fd_ < 0) {
+      fprintf(stderr, "cannot open %s: %m\n", options.render_node.c_str());
+      return false;
+    }
+    gbm_ = gbm_create_device(drm_fd_);
+    if (!gbm_) {
+      fprintf(stderr, "cannot create gbm device.\n");
+      return false;
+    }
+
+    buffers_.resize(options.num_buffers);
+    for (Buffer& buffer : buffers_) {
+      buffer.bo = gbm_bo_create(gbm_, options.width, options.height,
+                                GBM_FORMAT_ARGB8888, GBM_BO_USE_LINEAR);
+      if (!buffer.bo) {
+        fprintf(stderr, "failed to create a gbm buffer.\n");
+        return false;
+      }
+      buffer.fd = gbm_bo_get_fd(buffer.bo);
+      buffer.dimension.width = options.width;
+      buffer.dimension.height = options.height;
+      buffer.dimension.stride = gbm_bo_get_stride(buffer.bo);
+      buffer.addr = mmap(nullptr,
+                         buffer.dimension.stride * buffer.dimension.height,
+                         PROT_READ | PROT_WRITE, MAP_SHARED, buffer.fd, 0);
+      if (buffer.fd < 0 || buffer.addr == MAP_FAILED) {
+        buffer.addr = nullptr;
+        fprintf(stderr, "failed to mmap dma_buf: %m\n");
+        return false;
+      }
+    }
+
+    socket_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, options.socket_path.c_str(),
+            sizeof(addr.sun_path) - 1);
+    if (socket_fd_ < 0 ||
+        connect(socket_fd_, reinterpret_cast<sockaddr*>(&addr),
+                sizeof(addr))) {
+      fprintf(stderr, "cannot connect to %s: %m\n",
+              options.socket_path.c_str());
+      return false;
+    }
+
+    loop_ = ged::EventLoop::Create();
+    if (!loop_)
+      return false;
+    for (int signo : {SIGINT, SIGTERM})
+      loop_->AddSignal(signo, [this](int) { loop_->Quit(); });
+    loop_->AddFD(socket_fd_, EPOLLIN, [this](uint32_t) { Read(); });
+    uint64_t interval = 1000000 / std::max(options.rate, 1);
+    loop_->AddTimer(0, interval, [this](uint64_t) { Submit(); });
+    return true;
+  }
+
+  bool Run() { return loop_->Run(); }
+
+ private:
+  void Submit() {
+    // The compositor still has every buffer; skip the frame.
+    Buffer* buffer = nullptr;
+    uint32_t buffer_id = 0;
+    for (size_t i = 0; i < buffers_.size() && !buffer; ++i) {
+      buffer_id = (next_ + i) % buffers_.size();
+      if (!buffers_[buffer_id].busy)
+        buffer = &buffers_[buffer_id];
+    }
+    if (!buffer) {
+      ++skipped_;
+      return;
+    }
+    next_ = buffer_id + 1;
+
+    SyncDmaBuf(buffer->fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE);
+    demo::FillCheckPattern(buffer->addr, buffer->dimension,
+                           (frame_ % 100) / 100.f, (frame_ / 100) & 1);
+    SyncDmaBuf(buffer->fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE);
+    ++frame_;
+
+    // The CPU is done writing, so there's no fence. A GPU producer would
+    // send the sync_file of its rendering along.
+    ged::Compositor::SubmitMessage message = {};
+    message.type = ged::Compositor::SUBMIT;
+    message.buffer_id = buffer_id;
+    message.width = options_.width;
+    message.height = options_.height;
+    message.format = GBM_FORMAT_ARGB8888;
+    message.num_planes = 1;
+    message.modifier = gbm_bo_get_modifier(buffer->bo);
+    message.strides[0] = buffer->dimension.stride;
+    message.output = options_.output;
+    message.x = options_.x;
+    message.y = options_.y;
+    message.dst_width = options_.width;
+    message.dst_height = options_.height;
+    message.zpos = options_.zpos;
+
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    iovec iov = {&message, sizeof(message)};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &buffer->fd, sizeof(int));
+    if (sendmsg(socket_fd_, &msg, MSG_NOSIGNAL) != sizeof(message)) {
+      fprintf(stderr, "cannot submit: %m\n");
+      loop_->Quit();
+      return;
+    }
+    buffer->busy = true;
+  }
+
+  void Read() {
+    ged::Compositor::ReleaseMessage message;
+    ssize_t size = recv(socket_fd_, &message, sizeof(message), MSG_DONTWAIT);
+    if (size <= 0) {
+      if (size < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+      printf("the compositor hung up.\n");
+      loop_->Quit();
+      return;
+    }
+    if (size != sizeof(message) ||
+        message.type != ged::Compositor::RELEASE ||
+        message.buffer_id >= buffers_.size()) {
+      fprintf(stderr, "bad message from the compositor.\n");
+      return;
+    }
+    buffers_[message.buffer_id].busy = false;
+    if (!(++released_ % 60)) {
+      printf("released %zu buffers, skipped %zu frames\n", released_,
+             skipped_);
+    }
+  }
+
+  static void SyncDmaBuf(int fd, uint64_t flags) {
+    dma_buf_sync sync = {flags};
+    while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) == -1 &&
+           (errno == EINTR || errno == EAGAIN)) {
+    }
+  }
+
+  Options options_;
+  int drm_fd_ = -1;
+  struct gbm_device* gbm_ = nullptr;
+  std::vector<Buffer> buffers_;
+  int socket_fd_ = -1;
+  std::unique_ptr<ged::EventLoop> loop_;
+  size_t next_ = 0;
+  uint64_t frame_ = 0;
+  size_t released_ = 0;
+  size_t skipped_ = 0;
+};
+
+const char* shortopts = "B:C:N:O:R:W:H:X:Y:Z:";
+
+const struct option longopts[] = {{"buffers", required_argument, 0, 'B'},
+                                  {"compositor", required_argument, 0, 'C'},
+                                  {"render-node", required_argument, 0, 'N'},
+                                  {"output", required_argument, 0, 'O'},
+                                  {"rate", required_argument, 0, 'R'},
+                                  {"width", required_argument, 0, 'W'},
+                                  {"height", required_argument, 0, 'H'},
+                                  {"x", required_argument, 0, 'X'},
+                                  {"y", required_argument, 0, 'Y'},
+                                  {"zpos", required_argument, 0, 'Z'},
+                                  {0, 0, 0, 0}};
+
+void usage(const char* name) {
+  printf(
+      "Usage: %s [-BCNORWHXYZ]\n"
+      "\n"
+      "options:\n"
+      "    -B, --buffers=N          cycle through N buffers (default 3)\n"
+      "    -C, --compositor=SOCKET  the socket of gbm_es2_demo -C\n"
+      "                             (default /tmp/ged-compositor)\n"
+      "    -N, --render-node=NODE   allocate on NODE\n"
+      "                             (default /dev/dri/renderD128)\n"
+      "    -O, --output=N           show it on the output N (default 0)\n"
+      "    -R, --rate=HZ            submit HZ frames a second (default 60)\n"
+      "    -W, --width=W            (default 256)\n"
+      "    -H, --height=H           (default 256)\n"
+      "    -X, --x=X                (default 0)\n"
+      "    -Y, --y=Y                (default 0)\n"
+      "    -Z, --zpos=Z             (default 1)\n",
+      name);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  int opt;
+
+  while ((opt = getopt_long_only(argc, argv, shortopts, longopts, nullptr)) !=
+         -1) {
+    switch (opt) {
+      case 'B':
+        options.num_buffers = std::strtoul(optarg, nullptr, 10);
+        break;
+      case 'C':
+        options.socket_path = optarg;
+        break;
+      case 'N':
+        options.render_node = optarg;
+        break;
+      case 'O':
+        options.output = std::strtoul(optarg, nullptr, 10);
+        break;
+      case 'R':
+        options.rate = std::atoi(optarg);
+        break;
+      case 'W':
+        options.width = std::atoi(optarg);
+        break;
+      case 'H':
+        options.height = std::atoi(optarg);
+        break;
+      case 'X':
+        options.x = std::atoi(optarg);
+        break;
+      case 'Y':
+        options.y = std::atoi(optarg);
+        break;
+      case 'Z':
+        options.zpos = std::atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+  if (!options.num_buffers || options.width <= 0 || options.height <= 0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  Client client;
+  if (!client.Initialize(options)) {
+    fprintf(stderr, "failed to initialize the client.\n");
+    return -1;
+  }
+  if (!client.Run())
+    return -1;
+  return 0;
+}
@@ -37,12 +37,16 @@
 
 #include <cassert>
 #include <cmath>
+#include <csignal>
 #include <cstring>
 #include <memory>
 
 #include "drm_modesetter.h"
+#include "event_loop.h"
+#include "frame_stats.h"
 #include "gbm_es2_demo.h"
 #include "matrix.h"
+#include "pixel_kernels.h"
 
 namespace demo {
 
@@ -52,32 +56,66 @@ ES2CubeMapImpl::~ES2CubeMapImpl() {
   stream_texture_.reset();
 }
 
-bool ES2CubeMapImpl::Initialize(std::string card, bool atomic) {
-  std::unique_ptr<ged::DRMModesetter> drm =
-      ged::DRMModesetter::Create(card, atomic);
+bool ES2CubeMapImpl::Initialize(const Options& options) {
+  std::unique_ptr<ged::DRMModesetter> drm = CreateModesetter(options);
   if (!drm) {
     fprintf(stderr, "failed to create DRMModesetter.\n");
     return false;
   }
 
   egl_ = ged::EGLDRMGlue::Create(
-      std::move(drm), std::bind(&ES2CubeMapImpl::DidSwapBuffer, this,
-                                std::placeholders::_1, std::placeholders::_2));
+      std::move(drm),
+      std::bind(&ES2CubeMapImpl::DidSwapBuffer, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3),
+      options.num_buffers, options.threaded, GetFramebufferFormats(options));
   if (!egl_) {
     fprintf(stderr, "failed to create EGLDRMGlue.\n");
     return false;
   }
 
-  display_size_ = egl_->GetDisplaySize();
+  egl_->SetDetectMappingReads(options.detect_map_reads);
+  egl_->SetScanoutStreamTextures(options.overlay);
+  egl_->SetRenderLate(options.render_late);
+  duration_ = options.duration;
+  stats_file_ = options.stats_file;
+
+  producer_ = ged::TiledProducer::Create(options.fill_threads);
+  if (!producer_)
+    return false;
+  printf("filling the stream texture on %zu threads\n",
+         producer_->GetNumThreads());
 
   // Need to do the first mode setting before page flip.
   if (!InitializeGL())
     return false;
+
+  // The bottom right quarter of the first display.
+  if (options.overlay) {
+    ged::EGLDRMGlue::Size size = egl_->GetDisplaySize(0);
+    ged::EGLDRMGlue::Rect dst = {size.width / 2, size.height / 2,
+                                 size.width / 2, size.height / 2};
+    bool on_plane = egl_->AttachOverlay(stream_texture_.get(), 0, dst, 1);
+    printf("overlay: %s\n", on_plane ? "plane" : "GL");
+  }
   return true;
 }
 
 bool ES2CubeMapImpl::Run() {
-  return egl_->Run();
+  // Finish the last page flip on Ctrl+C, instead of dying in the middle.
+  ged::EventLoop* loop = egl_->GetEventLoop();
+  for (int signo : {SIGINT, SIGTERM}) {
+    loop->AddSignal(signo, [this](int) {
+      printf("exit due to signal\n");
+      egl_->Stop();
+    });
+  }
+  if (duration_ > 0) {
+    loop->AddTimer(duration_ * 1000000, 0,
+                   [this](uint64_t) { egl_->Stop(); });
+  }
+  if (!egl_->Run())
+    return false;
+  return WriteFrameStats(egl_.get(), stats_file_);
 }
 
 bool ES2CubeMapImpl::InitializeGL() {
@@ -248,7 +286,6 @@ bool ES2CubeMapImpl::InitializeGL() {
   GLuint samplerLoc = glGetUniformLocation(program_, "s_texture");
   glUniform1i(samplerLoc, 0);
 
-  glViewport(0, 0, display_size_.width, display_size_.height);
   glEnable(GL_CULL_FACE);
 
   GLintptr positionsoffset = 0;
@@ -285,7 +322,9 @@ bool ES2CubeMapImpl::InitializeGL() {
   glClearColor(0.0, 0.0, 0.0, 1.0);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  stream_texture_ = egl_->CreateStreamTexture(s_length, s_length);
+  // Write one texture while the GPU samples the others.
+  static const size_t num_slots = 3;
+  stream_texture_ = egl_->CreateStreamTexture(s_length, s_length, num_slots);
   if (!stream_texture_)
     return false;
 
@@ -405,22 +444,22 @@ bool ES2CubeMapImpl::InitializeGLProgram() {
   return true;
 }
 
-void ES2CubeMapImpl::DidSwapBuffer(GLuint gl_framebuffer, unsigned long usec) {
-  Draw(usec);
+void ES2CubeMapImpl::DidSwapBuffer(GLuint gl_framebuffer,
+                                   const ged::FrameTiming& timing,
+                                   size_t output) {
+  // Move to where the cube is when the frame is on the screen.
+  unsigned long usec = timing.presentation_ns / 1000;
+  Draw(usec, output);
 
-  static int num_frames = 0;
   static unsigned long lasttime = 0;
   static const size_t one_sec = 1000000;
-  num_frames++;
-  unsigned long elapsed = usec - lasttime;
-  if (elapsed > one_sec) {
-    printf("FPS: %4f \n", num_frames / ((double)elapsed / one_sec));
-    num_frames = 0;
+  if (output == 0 && usec - lasttime > one_sec) {
+    PrintFrameStats(egl_.get());
     lasttime = usec;
   }
 }
 
-void ES2CubeMapImpl::Draw(unsigned long usec) {
+void ES2CubeMapImpl::Draw(unsigned long usec, size_t output) {
   // 100% every 10 sec
   static const int interval = 10000000.f;
   float progress = 1.f * (usec % interval) / interval;
@@ -430,8 +469,10 @@ void ES2CubeMapImpl::Draw(unsigned long usec) {
   glClearColor(red, green, blue, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  // Update check pattern.
-  UpdateStreamTexture(usec);
+  // Update check pattern once per frame of the output 0; the other outputs
+  // show the latest one.
+  if (output == 0)
+    UpdateStreamTexture(usec);
 
   // Bind the texture
   glActiveTexture(GL_TEXTURE0);
@@ -439,14 +480,14 @@ void ES2CubeMapImpl::Draw(unsigned long usec) {
 
   // convert to 100ms precision, which covers 60FPS very enough.
   int i = usec / 10000;
-  ged::Matrix modelview;
-  modelview.Translate(0.0f, 0.0f, -8.0f);
-  modelview.Rotate(45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
-  modelview.Rotate(45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
-  modelview.Rotate(10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
+  ged::Matrix modelview = ged::Matrix::FromTRS(
+      {0.0f, 0.0f, -8.0f},
+      {45.0f + (0.25f * i), 45.0f - (0.5f * i), 10.0f + (0.15f * i)},
+      {1.0f, 1.0f, 1.0f});
 
+  ged::EGLDRMGlue::Size display_size = egl_->GetDisplaySize(output);
   GLfloat aspect =
-      (GLfloat)(display_size_.width) / (GLfloat)(display_size_.height);
+      (GLfloat)(display_size.width) / (GLfloat)(display_size.height);
 
   ged::Matrix projection;
   float field_of_view = 35.f;
@@ -459,7 +500,7 @@ void ES2CubeMapImpl::Draw(unsigned long usec) {
   glUniformMatrix4fv(modelviewprojectionmatrix_, 1, GL_FALSE,
                      modelviewprojection.Data());
   float normal[9] = {};
-  modelview.Get3x3(&normal[0]);
+  modelview.GetNormalMatrix(&normal[0]);
   glUniformMatrix3fv(normalmatrix_, 1, GL_FALSE, normal);
 
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -475,36 +516,58 @@ void ES2CubeMapImpl::UpdateStreamTexture(unsigned long usec) {
   static const int interval = 2 * 1000000;
   float progress = 1.f * (usec % interval) / interval;
 
-  int* ptr = (int*)stream_texture_->Map();
-  assert(ptr);
-
-  // Fill check pattern sliding to x axis as time goes on.
-  ged::StreamTexture::Dimension dimension = stream_texture_->GetDimension();
-  static const size_t byte_per_pixel = 4;
-  int row_color[2][s_length] = {};
-  std::memset(&row_color[0][0], 0, s_length * byte_per_pixel);
-  std::memset(&row_color[1][0], -1, s_length * byte_per_pixel);
-  static const size_t pattern_width = 64;
-  for (size_t x = progress * pattern_width; x < s_length;) {
-    assert(s_length >= x);
-    size_t step = std::min(s_length - x, pattern_width) * byte_per_pixel;
-    std::memset(&row_color[0][x], -1, step);
-    std::memset(&row_color[1][x], 0, step);
-    x += pattern_width * 2;
-  }
-
   if (last_progress_ > progress)
     even_turn_ = !even_turn_;
-
-  for (int y = 0; y < dimension.height; y++) {
-    size_t index =
-        (y % (2 * pattern_width) < pattern_width) ^ even_turn_ ? 0 : 1;
-    std::copy(&row_color[index][0], &row_color[index][0] + s_length,
-              &ptr[y * dimension.stride / byte_per_pixel]);
-  }
-  stream_texture_->Unmap();
+  bool even_turn = even_turn_;
+  bool ret = producer_->Produce(
+      stream_texture_.get(), ged::StreamTexture::Access::WRITE,
+      [progress, even_turn](const ged::TiledProducer::Tile& tile) {
+        FillCheckPattern(tile, progress, even_turn);
+      });
+  assert(ret);
+  (void)ret;
 
   last_progress_ = progress;
 }
 
+void FillCheckPattern(void* pixels,
+                      const ged::StreamTexture::Dimension& dimension,
+                      float progress,
+                      bool even_turn) {
+  ged::TiledProducer::Tile tile;
+  tile.pixels = static_cast<uint8_t*>(pixels);
+  tile.x = 0;
+  tile.y = 0;
+  tile.width = dimension.width;
+  tile.height = dimension.height;
+  tile.stride = dimension.stride;
+  FillCheckPattern(tile, progress, even_turn);
+}
+
+void FillCheckPattern(const ged::TiledProducer::Tile& tile,
+                      float progress,
+                      bool even_turn) {
+  // Fill check pattern sliding to x axis as time goes on. The pattern is
+  // anchored to the texture, not to the tile.
+  static const size_t pattern_width = 64;
+  uint32_t pattern[2 * pattern_width];
+  ged::pixel::Fill(pattern, pattern_width, 0xffffffff);
+  ged::pixel::Fill(pattern + pattern_width, pattern_width, 0);
+
+  size_t offset = progress * pattern_width;
+  size_t phase = (tile.x + 2 * pattern_width - offset) % (2 * pattern_width);
+  for (int i = 0; i < tile.height; i++) {
+    size_t y = tile.y + i;
+    // The other rows start from the inverted half of the pattern.
+    bool inverted =
+        !((y % (2 * pattern_width) < pattern_width) ^ even_turn);
+    ged::pixel::StreamFillPattern(
+        reinterpret_cast<uint32_t*>(tile.pixels + i * tile.stride),
+        tile.width, pattern, 2 * pattern_width,
+        phase + (inverted ? pattern_width : 0));
+  }
+  // Tiles are filled on worker threads, so land the stores before joining.
+  ged::pixel::StreamFence();
+}
+
 }  // namespace demo
@@ -25,46 +25,126 @@
 
 /* Based on a egl cube test app originally written by Arvin Schnell */
 
+#include <drm_fourcc.h>
+
 #include <cmath>
+#include <csignal>
 #include <memory>
 
 #include "drm_modesetter.h"
+#include "event_loop.h"
+#include "frame_stats.h"
 #include "gbm_es2_demo.h"
 #include "matrix.h"
 
 namespace demo {
 
+std::unique_ptr<ged::DRMModesetter> CreateModesetter(const Options& options) {
+  std::unique_ptr<ged::DRMModesetter> drm;
+  if (!options.headless) {
+    drm = ged::DRMModesetter::Create(options.card, options.atomic);
+  } else {
+    ged::DRMModesetter::HeadlessConfig config;
+    config.render_node = options.render_node;
+    config.refresh_rate = options.refresh_rate;
+    drm = ged::DRMModesetter::CreateHeadless(config);
+  }
+  if (drm)
+    drm->SetWatchStdin(options.watch_stdin);
+  return drm;
+}
+
+std::vector<uint32_t> GetFramebufferFormats(const Options& options) {
+  std::vector<uint32_t> formats;
+  if (!options.format.empty()) {
+    // Short codes such as "R8" are padded with spaces.
+    std::string code = options.format + "   ";
+    formats.push_back(fourcc_code(code[0], code[1], code[2], code[3]));
+  }
+  formats.push_back(DRM_FORMAT_XRGB8888);
+  return formats;
+}
+
+bool WriteFrameStats(ged::EGLDRMGlue* egl, const std::string& path) {
+  if (path.empty())
+    return true;
+  FILE* file = fopen(path.data(), "w");
+  if (!file) {
+    fprintf(stderr, "cannot open '%s': %m\n", path.data());
+    return false;
+  }
+  fprintf(file, "%s\n", egl->GetFrameStats()->ToJSON().c_str());
+  fclose(file);
+  return true;
+}
+
+void PrintFrameStats(ged::EGLDRMGlue* egl) {
+  size_t num_outputs = egl->GetOutputCount();
+  if (num_outputs == 1) {
+    printf("%s\n", egl->GetFrameStats()->ToString().c_str());
+    return;
+  }
+  for (size_t i = 0; i < num_outputs; ++i)
+    printf("output %zu: %s\n", i, egl->GetFrameStats(i)->ToString().c_str());
+}
+
 ES2CubeImpl::~ES2CubeImpl() {
   glDeleteBuffers(1, &vbo_);
   glDeleteProgram(program_);
 }
 
-bool ES2CubeImpl::Initialize(std::string card, bool atomic) {
-  std::unique_ptr<ged::DRMModesetter> drm =
-      ged::DRMModesetter::Create(card, atomic);
+bool ES2CubeImpl::Initialize(const Options& options) {
+  std::unique_ptr<ged::DRMModesetter> drm = CreateModesetter(options);
   if (!drm) {
     fprintf(stderr, "failed to create DRMModesetter.\n");
     return false;
   }
 
   egl_ = ged::EGLDRMGlue::Create(
-      std::move(drm), std::bind(&ES2CubeImpl::DidSwapBuffer, this,
-                                std::placeholders::_1, std::placeholders::_2));
+      std::move(drm),
+      std::bind(&ES2CubeImpl::DidSwapBuffer, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3),
+      options.num_buffers, options.threaded, GetFramebufferFormats(options));
   if (!egl_) {
     fprintf(stderr, "failed to create EGLDRMGlue.\n");
     return false;
   }
 
-  display_size_ = egl_->GetDisplaySize();
+  egl_->SetRenderLate(options.render_late);
+  duration_ = options.duration;
+  stats_file_ = options.stats_file;
 
   // Need to do the first mode setting before page flip.
   if (!InitializeGL())
     return false;
+
+  if (!options.compositor_socket.empty()) {
+    compositor_ =
+        ged::Compositor::Create(egl_.get(), options.compositor_socket);
+    if (!compositor_) {
+      fprintf(stderr, "failed to create Compositor.\n");
+      return false;
+    }
+  }
   return true;
 }
 
 bool ES2CubeImpl::Run() {
-  return egl_->Run();
+  // Finish the last page flip on Ctrl+C, instead of dying in the middle.
+  ged::EventLoop* loop = egl_->GetEventLoop();
+  for (int signo : {SIGINT, SIGTERM}) {
+    loop->AddSignal(signo, [this](int) {
+      printf("exit due to signal\n");
+      egl_->Stop();
+    });
+  }
+  if (duration_ > 0) {
+    loop->AddTimer(duration_ * 1000000, 0,
+                   [this](uint64_t) { egl_->Stop(); });
+  }
+  if (!egl_->Run())
+    return false;
+  return WriteFrameStats(egl_.get(), stats_file_);
 }
 
 bool ES2CubeImpl::InitializeGL() {
@@ -175,7 +255,6 @@ bool ES2CubeImpl::InitializeGL() {
       glGetUniformLocation(program_, "modelviewprojectionMatrix");
   normalmatrix_ = glGetUniformLocation(program_, "normalMatrix");
 
-  glViewport(0, 0, display_size_.width, display_size_.height);
   glEnable(GL_CULL_FACE);
 
   GLintptr positionsoffset = 0;
@@ -308,22 +387,25 @@ bool ES2CubeImpl::InitializeGLProgram() {
   return true;
 }
 
-void ES2CubeImpl::DidSwapBuffer(GLuint gl_framebuffer, unsigned long usec) {
-  Draw(usec);
+void ES2CubeImpl::DidSwapBuffer(GLuint gl_framebuffer,
+                                const ged::FrameTiming& timing,
+                                size_t output) {
+  // The client buffers are drawn over the cube, or put on planes.
+  if (compositor_)
+    compositor_->Update(output);
+  // Move to where the cube is when the frame is on the screen.
+  unsigned long usec = timing.presentation_ns / 1000;
+  Draw(usec, output);
 
-  static int num_frames = 0;
   static unsigned long lasttime = 0;
   static const size_t one_sec = 1000000;
-  num_frames++;
-  unsigned long elapsed = usec - lasttime;
-  if (elapsed > one_sec) {
-    printf("FPS: %4f \n", num_frames / ((double)elapsed / one_sec));
-    num_frames = 0;
+  if (output == 0 && usec - lasttime > one_sec) {
+    PrintFrameStats(egl_.get());
     lasttime = usec;
   }
 }
 
-void ES2CubeImpl::Draw(unsigned long usec) {
+void ES2CubeImpl::Draw(unsigned long usec, size_t output) {
   // 100% every 10 sec
   static const int interval = 10000000.f;
   float progress = 1.f * (usec % interval) / interval;
@@ -335,14 +417,14 @@ void ES2CubeImpl::Draw(unsigned long usec) {
 
   // convert to 200ms precision, which covers 60FPS very enough.
   int i = usec / 5000;
-  ged::Matrix modelview;
-  modelview.Translate(0.0f, 0.0f, -8.0f);
-  modelview.Rotate(45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
-  modelview.Rotate(45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
-  modelview.Rotate(10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
+  ged::Matrix modelview = ged::Matrix::FromTRS(
+      {0.0f, 0.0f, -8.0f},
+      {45.0f + (0.25f * i), 45.0f - (0.5f * i), 10.0f + (0.15f * i)},
+      {1.0f, 1.0f, 1.0f});
 
+  ged::EGLDRMGlue::Size display_size = egl_->GetDisplaySize(output);
   GLfloat aspect =
-      (GLfloat)(display_size_.width) / (GLfloat)(display_size_.height);
+      (GLfloat)(display_size.width) / (GLfloat)(display_size.height);
 
   ged::Matrix projection;
   float field_of_view = 35.f;
@@ -355,7 +437,7 @@ void ES2CubeImpl::Draw(unsigned long usec) {
   glUniformMatrix4fv(modelviewprojectionmatrix_, 1, GL_FALSE,
                      modelviewprojection.Data());
   float normal[9] = {};
-  modelview.Get3x3(&normal[0]);
+  modelview.GetNormalMatrix(&normal[0]);
   glUniformMatrix3fv(normalmatrix_, 1, GL_FALSE, normal);
 
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -25,11 +25,70 @@
 
 #include <GLES2/gl2.h>
 #include <string>
+#include <vector>
 
+#include "compositor.h"
+#include "drm_modesetter.h"
 #include "egl_drm_glue.h"
+#include "tiled_producer.h"
 
 namespace demo {
 
+struct Options {
+  std::string card = "/dev/dri/card0";
+  bool atomic = false;
+  size_t num_buffers = 2;
+  bool threaded = false;
+  // start every frame as late as it can still make its VBlank
+  bool render_late = false;
+  // render without a display; |card| is ignored
+  bool headless = false;
+  // for |headless|, empty to render without GBM
+  std::string render_node;
+  // for |headless|, 0 means uncapped
+  int refresh_rate = 60;
+  // threads filling the stream texture of ES2CubeMapImpl; 0 is one per core
+  size_t fill_threads = 0;
+  // report reads from the stream texture mapping of ES2CubeMapImpl
+  bool detect_map_reads = false;
+  // also show the stream texture of ES2CubeMapImpl in a corner, on an overlay
+  // plane if there's one
+  bool overlay = false;
+  // stop after this many seconds, if not 0
+  double duration = 0;
+  // stop on any input on stdin
+  bool watch_stdin = true;
+  // where to write the frame stats in JSON at exit, if not empty
+  std::string stats_file;
+  // the DRM fourcc of the framebuffers, e.g. "RG16"; XRGB8888 if it's empty
+  // or unsupported
+  std::string format;
+  // for ES2CubeImpl, show the buffers of compositor clients connecting to
+  // this socket, if not empty
+  std::string compositor_socket;
+};
+
+// Creates the modesetter the options ask for.
+std::unique_ptr<ged::DRMModesetter> CreateModesetter(const Options& options);
+// The framebuffer formats to pass to EGLDRMGlue::Create().
+std::vector<uint32_t> GetFramebufferFormats(const Options& options);
+
+// Writes the frame stats of |egl| into |path|, unless |path| is empty.
+bool WriteFrameStats(ged::EGLDRMGlue* egl, const std::string& path);
+// Prints one line of frame stats per output.
+void PrintFrameStats(ged::EGLDRMGlue* egl);
+
+// Fills |pixels| with the check pattern of ES2CubeMapImpl. It slides along
+// the x axis as |progress| goes from 0 to 1, and |even_turn| flips the rows.
+void FillCheckPattern(void* pixels,
+                      const ged::StreamTexture::Dimension& dimension,
+                      float progress,
+                      bool even_turn);
+// Fills only |tile| of the same pattern.
+void FillCheckPattern(const ged::TiledProducer::Tile& tile,
+                      float progress,
+                      bool even_turn);
+
 class ES2Cube {
  public:
   ES2Cube() = default;
@@ -37,25 +96,32 @@ class ES2Cube {
   ES2Cube(const ES2Cube&) = delete;
   void operator=(const ES2Cube&) = delete;
 
-  virtual bool Initialize(std::string card, bool atomic) = 0;
+  virtual bool Initialize(const Options& options) = 0;
   virtual bool Run() = 0;
+  virtual ged::FrameStats* GetFrameStats() = 0;
 };
 
 class ES2CubeImpl : public ES2Cube {
  public:
   ES2CubeImpl() = default;
   ~ES2CubeImpl() override;
-  bool Initialize(std::string card, bool atomic) override;
+  bool Initialize(const Options& options) override;
   bool Run() override;
+  ged::FrameStats* GetFrameStats() override { return egl_->GetFrameStats(); }
 
  private:
   bool InitializeGL();
   bool InitializeGLProgram();
-  void DidSwapBuffer(GLuint gl_framebuffer, unsigned long usec);
-  void Draw(unsigned long usec);
+  void DidSwapBuffer(GLuint gl_framebuffer,
+                     const ged::FrameTiming& timing,
+                     size_t output);
+  void Draw(unsigned long usec, size_t output);
 
   std::unique_ptr<ged::EGLDRMGlue> egl_;
-  ged::EGLDRMGlue::Size display_size_ = {};
+  // destroyed before |egl_|
+  std::unique_ptr<ged::Compositor> compositor_;
+  double duration_ = 0;
+  std::string stats_file_;
   GLuint program_ = 0;
   GLint modelviewmatrix_ = 0;
   GLint modelviewprojectionmatrix_ = 0;
@@ -68,18 +134,22 @@ class ES2CubeMapImpl : public ES2Cube {
   ES2CubeMapImpl() = default;
   ~ES2CubeMapImpl() override;
 
-  bool Initialize(std::string card, bool atomic) override;
+  bool Initialize(const Options& options) override;
   bool Run() override;
+  ged::FrameStats* GetFrameStats() override { return egl_->GetFrameStats(); }
 
  private:
   bool InitializeGL();
   bool InitializeGLProgram();
-  void DidSwapBuffer(GLuint gl_framebuffer, unsigned long usec);
-  void Draw(unsigned long usec);
+  void DidSwapBuffer(GLuint gl_framebuffer,
+                     const ged::FrameTiming& timing,
+                     size_t output);
+  void Draw(unsigned long usec, size_t output);
   void UpdateStreamTexture(unsigned long usec);
 
   std::unique_ptr<ged::EGLDRMGlue> egl_;
-  ged::EGLDRMGlue::Size display_size_ = {};
+  double duration_ = 0;
+  std::string stats_file_;
   GLuint program_ = 0;
   GLint modelviewmatrix_ = 0;
   GLint modelviewprojectionmatrix_ = 0;
@@ -87,6 +157,7 @@ class ES2CubeMapImpl : public ES2Cube {
   GLuint vbo_ = 0;
   static const size_t s_length = 512;
   std::unique_ptr<ged::StreamTexture> stream_texture_;
+  std::unique_ptr<ged::TiledProducer> producer_;
 
   // For check pattern.
   float last_progress_ = 0.f;
@@ -24,31 +24,68 @@
 /* Based on a egl cube test app originally written by Arvin Schnell */
 
 #include <getopt.h>
+#include <cstdlib>
 #include <string>
 
 #include "gbm_es2_demo.h"
 
-static const char* shortopts = "AD:M";
+static const char* shortopts = "AB:C:D:EF:HL:MN:OP:RS:TW:";
 
 static const struct option longopts[] = {{"atomic", no_argument, 0, 'A'},
+                                         {"buffers", required_argument, 0, 'B'},
+                                         {"compositor", required_argument, 0,
+                                          'C'},
                                          {"device", required_argument, 0, 'D'},
+                                         {"render-late", no_argument, 0, 'E'},
+                                         {"refresh", required_argument, 0, 'F'},
+                                         {"headless", no_argument, 0, 'H'},
+                                         {"duration", required_argument, 0,
+                                          'L'},
                                          {"map", no_argument, 0, 'M'},
+                                         {"render-node", required_argument, 0,
+                                          'N'},
+                                         {"overlay", no_argument, 0, 'O'},
+                                         {"format", required_argument, 0, 'P'},
+                                         {"detect-reads", no_argument, 0, 'R'},
+                                         {"stats", required_argument, 0, 'S'},
+                                         {"threaded", no_argument, 0, 'T'},
+                                         {"workers", required_argument, 0, 'W'},
                                          {0, 0, 0, 0}};
 
 static void usage(const char* name) {
   printf(
-      "Usage: %s [-ADMmV]\n"
+      "Usage: %s [-ABCDEFHLMNOPRSTW]\n"
       "\n"
       "options:\n"
       "    -A, --atomic             use atomic modesetting and fencing\n"
+      "    -B, --buffers=N          use N framebuffers (2-4, default 2)\n"
+      "    -C, --compositor=SOCKET  show the buffers of the clients of\n"
+      "                             SOCKET over the cube\n"
       "    -D, --device=DEVICE      use the given device\n"
-      "    -M, --map                mmap test\n",
+      "    -E, --render-late        start drawing as late as the VBlank\n"
+      "                             allows, for lower latency\n"
+      "    -F, --refresh=HZ         headless refresh rate (default 60, 0 is\n"
+      "                             uncapped)\n"
+      "    -H, --headless           render without a display; stdin\n"
+      "                             doesn't stop it\n"
+      "    -L, --duration=SEC       exit after SEC seconds\n"
+      "    -M, --map                mmap test\n"
+      "    -N, --render-node=NODE   headless render node (default none)\n"
+      "    -O, --overlay            also show the mmap test texture on an\n"
+      "                             overlay plane\n"
+      "    -P, --format=FOURCC      framebuffer format, e.g. RG16 or XR30\n"
+      "                             (default XR24)\n"
+      "    -R, --detect-reads       report reads from the mmap test texture\n"
+      "                             (x86 only, slow)\n"
+      "    -S, --stats=FILE         write frame stats in JSON to FILE\n"
+      "    -T, --threaded           render on a dedicated thread\n"
+      "    -W, --workers=N          fill the mmap test texture on N threads\n"
+      "                             (default 0, one per core)\n",
       name);
 }
 
 int main(int argc, char* argv[]) {
-  const char* card = "/dev/dri/card0";
-  bool atomic = false;
+  demo::Options options;
   bool map = false;
   int opt;
 
@@ -56,14 +93,55 @@ int main(int argc, char* argv[]) {
          -1) {
     switch (opt) {
       case 'A':
-        atomic = true;
+        options.atomic = true;
+        break;
+      case 'B':
+        options.num_buffers = std::strtoul(optarg, nullptr, 10);
+        break;
+      case 'C':
+        options.compositor_socket = optarg;
         break;
       case 'D':
-        card = optarg;
+        options.card = optarg;
+        break;
+      case 'E':
+        options.render_late = true;
+        break;
+      case 'F':
+        options.refresh_rate = std::atoi(optarg);
+        break;
+      case 'H':
+        // It runs in scripts, whose stdin may be at its EOF already.
+        options.headless = true;
+        options.watch_stdin = false;
+        break;
+      case 'L':
+        options.duration = std::strtod(optarg, nullptr);
         break;
       case 'M':
         map = true;
         break;
+      case 'N':
+        options.render_node = optarg;
+        break;
+      case 'O':
+        options.overlay = true;
+        break;
+      case 'P':
+        options.format = optarg;
+        break;
+      case 'R':
+        options.detect_map_reads = true;
+        break;
+      case 'S':
+        options.stats_file = optarg;
+        break;
+      case 'T':
+        options.threaded = true;
+        break;
+      case 'W':
+        options.fill_threads = std::strtoul(optarg, nullptr, 10);
+        break;
       default:
         usage(argv[0]);
         return -1;
@@ -76,7 +154,7 @@ int main(int argc, char* argv[]) {
   } else {
     demo.reset(new demo::ES2CubeImpl());
   }
-  if (!demo->Initialize(card, atomic)) {
+  if (!demo->Initialize(options)) {
     fprintf(stderr, "failed to initialize ES2Cube.\n");
     return -1;
   }
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "compositor.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "egl_drm_glue.h"
+#include "event_loop.h"
+
+namespace ged {
+
+namespace {
+
+// The planes and the fence.
+const size_t kMaxFds = Compositor::kMaxPlanes + 1;
+
+}  // namespace
+
+class Compositor::Impl {
+ public:
+  explicit Impl(EGLDRMGlue* glue)
+      : glue_(glue),
+        loop_(glue->GetEventLoop()),
+        frames_(glue->GetOutputCount(), 0) {}
+  Impl(const Impl&) = delete;
+  void operator=(const Impl&) = delete;
+
+  ~Impl() {
+    for (auto& client : clients_) {
+      if (client->fd >= 0)
+        Disconnect(client.get());
+      if (client->texture)
+        glue_->DetachOverlay(client->texture.get());
+    }
+    if (listen_fd_ >= 0) {
+      loop_->Remove(listen_fd_);
+      close(listen_fd_);
+      unlink(socket_path_.c_str());
+    }
+  }
+
+  bool Initialize(const std::string& socket_path) {
+    // Clients come and go on the loop thread, which has to be the one that
+    // attaches overlays.
+    if (glue_->IsThreaded()) {
+      fprintf(stderr, "the compositor can't run with a render thread.\n");
+      return false;
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "socket path too long: %s\n", socket_path.c_str());
+      return false;
+    }
+    memcpy(addr.sun_path, socket_path.c_str(), socket_path.size());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                        0);
+    if (listen_fd_ < 0) {
+      fprintf(stderr, "cannot create socket: %m\n");
+      return false;
+    }
+    if (!RemoveStaleSocket(addr)) {
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+        listen(listen_fd_, 16)) {
+      fprintf(stderr, "cannot listen on %s: %m\n", socket_path.c_str());
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+    socket_path_ = socket_path;
+    if (!loop_->AddFD(listen_fd_, EPOLLIN, [this](uint32_t) { Accept(); })) {
+      close(listen_fd_);
+      listen_fd_ = -1;
+      unlink(socket_path.c_str());
+      return false;
+    }
+    printf("compositor: listening on %s\n", socket_path.c_str());
+    return true;
+  }
+
+  // A socket nobody listens on was left by a compositor that crashed, most
+  // likely. Anything else at the path stays.
+  static bool RemoveStaleSocket(const sockaddr_un& addr) {
+    struct stat st;
+    if (lstat(addr.sun_path, &st))
+      return errno == ENOENT;
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "%s exists and is not a socket.\n", addr.sun_path);
+      return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+      fprintf(stderr, "cannot create socket: %m\n");
+      return false;
+    }
+    int ret = connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                      sizeof(addr));
+    int error = errno;
+    close(fd);
+    if (!ret || error != ECONNREFUSED) {
+      fprintf(stderr, "%s is in use.\n", addr.sun_path);
+      return false;
+    }
+    if (unlink(addr.sun_path) && errno != ENOENT) {
+      fprintf(stderr, "cannot remove %s: %m\n", addr.sun_path);
+      return false;
+    }
+    return true;
+  }
+
+  void Update(size_t output) {
+    uint64_t frame = ++frames_[output];
+    for (auto it = retired_.begin(); it != retired_.end();) {
+      if (it->output == output && frame >= it->frame)
+        it = retired_.erase(it);
+      else
+        ++it;
+    }
+
+    for (auto it = clients_.begin(); it != clients_.end();) {
+      Client* client = it->get();
+      if (client->fd < 0) {
+        Retire(client, output, frame);
+        it = clients_.erase(it);
+        continue;
+      }
+      ReleaseBuffers(client, output, frame);
+      ShowNewestCommit(client, output, frame);
+      ++it;
+    }
+  }
+
+  size_t GetClientCount() const { return clients_.size(); }
+
+ private:
+  struct Commit {
+    uint32_t buffer_id = 0;
+    // The fds are ours until the buffer is imported.
+    EGLDRMGlue::DmaBuf dma_buf;
+    size_t output = 0;
+    EGLDRMGlue::Rect dst = {};
+    int zpos = 0;
+    // the sync_file to wait for, or -1 once it signaled
+    int fence_fd = -1;
+  };
+
+  // |buffer_id| goes back to the client when |output| draws |frame|.
+  struct Release {
+    uint32_t buffer_id;
+    size_t output;
+    uint64_t frame;
+  };
+
+  struct Client {
+    // -1 once the client hung up
+    int fd = -1;
+    // in the order of submission
+    std::deque<Commit> commits;
+    // imports every buffer of the client
+    std::unique_ptr<StreamTexture> texture;
+    // what |texture| shows, if anything
+    bool showing = false;
+    uint32_t buffer_id = 0;
+    size_t output = 0;
+    EGLDRMGlue::Rect dst = {};
+    int zpos = 0;
+    std::vector<Release> releases;
+  };
+
+  // The texture of a client gone, until |output| draws |frame|.
+  struct Retired {
+    std::unique_ptr<StreamTexture> texture;
+    size_t output;
+    uint64_t frame;
+  };
+
+  // A frame is on the screen or read by the GPU until |num_buffers| + 1
+  // more frames of its output are drawn. One more than the swapchain holds,
+  // because with explicit fencing the buffer on the screen is freed early.
+  uint64_t GetIdleFrame(size_t output, size_t current_output, uint64_t frame) {
+    uint64_t last_shown =
+        output == current_output ? frame - 1 : frames_[output];
+    return last_shown + glue_->GetNumBuffers() + 1;
+  }
+
+  void Accept() {
+    while (true) {
+      int fd = accept4(listen_fd_, nullptr, nullptr,
+                       SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (fd < 0) {
+        if (errno == EINTR)
+          continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+          fprintf(stderr, "cannot accept a client: %m\n");
+        return;
+      }
+      std::unique_ptr<Client> client(new Client());
+      client->fd = fd;
+      Client* raw_client = client.get();
+      if (!loop_->AddFD(fd, EPOLLIN,
+                        [this, raw_client](uint32_t) { Read(raw_client); })) {
+        close(fd);
+        continue;
+      }
+      clients_.push_back(std::move(client));
+      printf("compositor: client %d connected\n", fd);
+    }
+  }
+
+  void Read(Client* client) {
+    while (client->fd >= 0) {
+      SubmitMessage message;
+      char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+      iovec iov = {&message, sizeof(message)};
+      msghdr msg = {};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      ssize_t size = recvmsg(client->fd, &msg, MSG_CMSG_CLOEXEC);
+      if (size < 0) {
+        if (errno == EINTR)
+          continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          return;
+        fprintf(stderr, "compositor: cannot read client %d: %m\n",
+                client->fd);
+        Disconnect(client);
+        return;
+      }
+      if (size == 0) {
+        printf("compositor: client %d hung up\n", client->fd);
+        Disconnect(client);
+        return;
+      }
+
+      std::vector<int> fds;
+      for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+           cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+          continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; ++i) {
+          int fd;
+          memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+          fds.push_back(fd);
+        }
+      }
+      bool truncated = msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC);
+      if (truncated || !Submit(client, message, size, fds)) {
+        fprintf(stderr, "compositor: bad message from client %d\n",
+                client->fd);
+        for (int fd : fds)
+          close(fd);
+        Disconnect(client);
+        return;
+      }
+    }
+  }
+
+  // Takes the ownership of |fds| only on success.
+  bool Submit(Client* client,
+              const SubmitMessage& message,
+              size_t size,
+              const std::vector<int>& fds) {
+    if (size != sizeof(message) || message.type != SUBMIT ||
+        !message.num_planes || message.num_planes > kMaxPlanes ||
+        fds.size() != message.num_planes + (message.has_fence ? 1 : 0) ||
+        message.output >= frames_.size()) {
+      return false;
+    }
+    // Fences that never signal, or a flood of submissions, would otherwise
+    // pile up fds until the process runs out of them.
+    if (client->commits.size() >= kMaxPendingCommits) {
+      fprintf(stderr, "compositor: client %d has too many pending buffers\n",
+              client->fd);
+      return false;
+    }
+
+    Commit commit;
+    commit.buffer_id = message.buffer_id;
+    commit.dma_buf.width = message.width;
+    commit.dma_buf.height = message.height;
+    commit.dma_buf.format = message.format;
+    commit.dma_buf.modifier = message.modifier;
+    for (size_t i = 0; i < message.num_planes; ++i) {
+      commit.dma_buf.planes.push_back(
+          {fds[i], message.offsets[i], message.strides[i]});
+    }
+    commit.output = message.output;
+    commit.dst = {message.x, message.y, message.dst_width,
+                  message.dst_height};
+    commit.zpos = message.zpos;
+    if (message.has_fence) {
+      int fence_fd = fds.back();
+      // A sync_file polls readable once it signals.
+      if (!loop_->AddFD(fence_fd, EPOLLIN, [this, client, fence_fd](uint32_t) {
+            DidSignal(client, fence_fd);
+          })) {
+        return false;
+      }
+      commit.fence_fd = fence_fd;
+    }
+    client->commits.push_back(commit);
+    return true;
+  }
+
+  void DidSignal(Client* client, int fence_fd) {
+    for (Commit& commit : client->commits) {
+      if (commit.fence_fd != fence_fd)
+        continue;
+      loop_->Remove(fence_fd);
+      close(fence_fd);
+      commit.fence_fd = -1;
+      return;
+    }
+  }
+
+  // The surface goes away at the next Update(), on the thread using GL.
+  void Disconnect(Client* client) {
+    loop_->Remove(client->fd);
+    close(client->fd);
+    client->fd = -1;
+    for (Commit& commit : client->commits)
+      CloseCommit(&commit);
+    client->commits.clear();
+  }
+
+  void CloseCommit(Commit* commit) {
+    if (commit->fence_fd >= 0) {
+      loop_->Remove(commit->fence_fd);
+      close(commit->fence_fd);
+      commit->fence_fd = -1;
+    }
+    for (const EGLDRMGlue::DmaBuf::Plane& plane : commit->dma_buf.planes)
+      close(plane.fd);
+    commit->dma_buf.planes.clear();
+  }
+
+  void Retire(Client* client, size_t output, uint64_t frame) {
+    if (!client->texture)
+      return;
+    glue_->DetachOverlay(client->texture.get());
+    Retired retired;
+    retired.texture = std::move(client->texture);
+    retired.output = client->output;
+    retired.frame = GetIdleFrame(client->output, output, frame);
+    retired_.push_back(std::move(retired));
+  }
+
+  void ReleaseBuffers(Client* client, size_t output, uint64_t frame) {
+    std::vector<Release>& releases = client->releases;
+    for (auto it = releases.begin(); it != releases.end();) {
+      if (it->output == output && frame >= it->frame) {
+        SendRelease(client, it->buffer_id);
+        it = releases.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Only the newest buffer whose fence signaled is shown, and the ones
+  // before it are given back unseen.
+  void ShowNewestCommit(Client* client, size_t output, uint64_t frame) {
+    std::deque<Commit>& commits = client->commits;
+    size_t ready = 0;
+    while (ready < commits.size() && commits[ready].fence_fd < 0)
+      ++ready;
+    if (!ready || commits[ready - 1].output != output)
+      return;
+
+    for (size_t i = 0; i + 1 < ready; ++i) {
+      CloseCommit(&commits[i]);
+      SendRelease(client, commits[i].buffer_id);
+    }
+    Commit& commit = commits[ready - 1];
+    bool imported;
+    if (client->texture) {
+      imported = glue_->ImportStreamTexture(client->texture.get(),
+                                            commit.dma_buf);
+    } else {
+      client->texture = glue_->ImportStreamTexture(commit.dma_buf);
+      imported = !!client->texture;
+    }
+    // The texture keeps fds of its own.
+    CloseCommit(&commit);
+    if (!imported) {
+      SendRelease(client, commit.buffer_id);
+    } else {
+      if (client->showing) {
+        client->releases.push_back(
+            {client->buffer_id, client->output,
+             GetIdleFrame(client->output, output, frame)});
+      }
+      const EGLDRMGlue::Rect& dst = commit.dst;
+      if (!client->showing || client->output != commit.output ||
+          client->dst.x != dst.x || client->dst.y != dst.y ||
+          client->dst.width != dst.width ||
+          client->dst.height != dst.height || client->zpos != commit.zpos) {
+        glue_->AttachOverlay(client->texture.get(), commit.output, commit.dst,
+                             commit.zpos);
+      }
+      client->showing = true;
+      client->buffer_id = commit.buffer_id;
+      client->output = commit.output;
+      client->dst = commit.dst;
+      client->zpos = commit.zpos;
+    }
+    commits.erase(commits.begin(), commits.begin() + ready);
+  }
+
+  void SendRelease(Client* client, uint32_t buffer_id) {
+    if (client->fd < 0)
+      return;
+    ReleaseMessage message = {RELEASE, buffer_id};
+    if (send(client->fd, &message, sizeof(message),
+             MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(message)) {
+      fprintf(stderr, "compositor: cannot release to client %d: %m\n",
+              client->fd);
+    }
+  }
+
+  EGLDRMGlue* const glue_;
+  EventLoop* const loop_;
+  int listen_fd_ = -1;
+  std::string socket_path_;
+  // how many frames each output has drawn
+  std::vector<uint64_t> frames_;
+  std::vector<std::unique_ptr<Client>> clients_;
+  std::vector<Retired> retired_;
+};
+
+// static
+std::unique_ptr<Compositor> Compositor::Create(EGLDRMGlue* glue,
+                                               const std::string& socket_path) {
+  std::unique_ptr<Compositor> compositor(new Compositor());
+  if (compositor->Initialize(glue, socket_path))
+    return compositor;
+  return nullptr;
+}
+
+Compositor::Compositor() {}
+
+Compositor::~Compositor() {}
+
+bool Compositor::Initialize(EGLDRMGlue* glue, const std::string& socket_path) {
+  impl_.reset(new Impl(glue));
+  return impl_->Initialize(socket_path);
+}
+
+void Compositor::Update(size_t output) {
+  impl_->Update(output);
+}
+
+size_t Compositor::GetClientCount() const {
+  return impl_->GetClientCount();
+}
+
+}  // namespace ged
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_COMPOSITOR_H_
+#define GED_COMPOSITOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ged {
+
+class EGLDRMGlue;
+
+/*
+ * Compositor lets other processes show their buffers on the displays of an
+ * EGLDRMGlue, without copying the pixels. Every client connects to a UNIX
+ * socket and has one surface, which shows the dma_buf it submitted last on
+ * an overlay plane, or drawn with GL over the frame if no plane fits.
+ *
+ * The socket is SOCK_SEQPACKET. A client sends SubmitMessage with the fd of
+ * every plane, and then an optional sync_file fence, as SCM_RIGHTS. The
+ * buffer is shown from the first frame after the fence signals. The
+ * compositor sends ReleaseMessage once the buffer is neither on the screen
+ * nor read by the GPU any more, after which the client may write or submit
+ * it again. A buffer replaced before it was ever shown is released right
+ * away, and so is one that can't be imported. A client with more than
+ * kMaxPendingCommits buffers submitted but not shown yet is disconnected.
+ */
+class Compositor {
+ public:
+  enum MessageType : uint32_t {
+    SUBMIT = 1,
+    RELEASE = 2,
+  };
+
+  static const size_t kMaxPlanes = 4;
+  // More than any client needs buffers in flight.
+  static const size_t kMaxPendingCommits = 16;
+
+  struct SubmitMessage {
+    uint32_t type;
+    // the client's name for the buffer, echoed in ReleaseMessage
+    uint32_t buffer_id;
+    uint32_t width;
+    uint32_t height;
+    // a DRM fourcc
+    uint32_t format;
+    uint32_t num_planes;
+    // DRM_FORMAT_MOD_INVALID if the client doesn't know
+    uint64_t modifier;
+    uint32_t offsets[kMaxPlanes];
+    uint32_t strides[kMaxPlanes];
+    // where to show it, scaled
+    uint32_t output;
+    int32_t x;
+    int32_t y;
+    int32_t dst_width;
+    int32_t dst_height;
+    // higher is on top
+    int32_t zpos;
+    // 1 if a sync_file fd follows the plane fds
+    uint32_t has_fence;
+    // 0; makes the size the same on every ABI
+    uint32_t reserved;
+  };
+
+  struct ReleaseMessage {
+    uint32_t type;
+    uint32_t buffer_id;
+  };
+
+  // Listens on |socket_path|, replacing a stale socket file. |glue| must
+  // not be threaded, and must outlive the compositor.
+  static std::unique_ptr<Compositor> Create(EGLDRMGlue* glue,
+                                            const std::string& socket_path);
+
+  // Destroy it after EGLDRMGlue::Run() returns.
+  ~Compositor();
+  Compositor(const Compositor&) = delete;
+  void operator=(const Compositor&) = delete;
+
+  // Shows the newest ready buffers of the clients on |output|, and releases
+  // the buffers the display is done with. Call it from the SwapBuffersCallback
+  // of every frame.
+  void Update(size_t output);
+
+  size_t GetClientCount() const;
+
+ private:
+  Compositor();
+
+  bool Initialize(EGLDRMGlue* glue, const std::string& socket_path);
+
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ged
+
+#endif  // GED_COMPOSITOR_H_
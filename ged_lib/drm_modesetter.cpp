@@ -26,15 +26,24 @@
 
 #include "drm_modesetter.h"
 
+#include <drm_fourcc.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <ctime>
 #include <iostream>
-#include <list>
+#include <map>
+#include <vector>
+
+#include "event_loop.h"
 
 namespace ged {
 
@@ -45,52 +54,140 @@ class DRMModesetter::Impl {
   void operator=(const Impl&) = delete;
 
   ~Impl() {
-    assert(!page_flip_pending_);
-    for (auto& dev : modeset_dev_list_) {
+    for (auto& dev : modeset_devs_) {
+      assert(!dev->page_flip_pending);
+      if (!dev->saved_crtc)
+        continue;
       /* restore saved CRTC configuration */
       drmModeSetCrtc(fd_, dev->saved_crtc->crtc_id, dev->saved_crtc->buffer_id,
                      dev->saved_crtc->x, dev->saved_crtc->y, &dev->conn, 1,
                      &dev->saved_crtc->mode);
       drmModeFreeCrtc(dev->saved_crtc);
+      if (dev->mode_blob_id)
+        drmModeDestroyPropertyBlob(fd_, dev->mode_blob_id);
     }
 
-    close(fd_);
+    /* the loop stops watching the fds before they are closed */
+    loop_.reset();
+    if (wakeup_fd_ >= 0)
+      close(wakeup_fd_);
+    if (fd_ >= 0)
+      close(fd_);
   }
 
-  void SetClient(DRMModesetter::Client* client) { client_ = client; }
+  void SetClient(size_t output, DRMModesetter::Client* client) {
+    modeset_devs_[output]->client = client;
+  }
   int GetFD() const { return fd_; }
+  bool IsHeadless() const { return headless_; }
+  size_t GetOutputCount() const { return modeset_devs_.size(); }
 
-  Size GetDisplaySize() const {
-    return {modeset_dev_->mode.hdisplay, modeset_dev_->mode.vdisplay};
+  Size GetDisplaySize(size_t output) const {
+    if (headless_)
+      return headless_size_;
+    const drmModeModeInfo& mode = modeset_devs_[output]->mode;
+    return {mode.hdisplay, mode.vdisplay};
+  }
+
+  uint64_t GetRefreshInterval(size_t output) const {
+    if (headless_)
+      return headless_refresh_interval_;
+    const drmModeModeInfo& mode = modeset_devs_[output]->mode;
+    /* the pixel clock is in kHz */
+    if (!mode.clock)
+      return 0;
+    return uint64_t(mode.htotal) * mode.vtotal * 1000 / mode.clock;
   }
 
   bool ModeSetCrtc() {
-    assert(modeset_dev_);
-    uint32_t fb_id = client_->GetFrameBuffer(front_buffer_);
+    if (headless_)
+      return true;
 
     /* perform actual modesetting on each found connector+CRTC */
-    modeset_dev_->saved_crtc = drmModeGetCrtc(fd_, modeset_dev_->crtc);
-    int ret = drmModeSetCrtc(fd_, modeset_dev_->crtc, fb_id, 0, 0,
-                             &modeset_dev_->conn, 1, &modeset_dev_->mode);
-    if (ret) {
-      fprintf(stderr, "cannot set CRTC for connector %u (%d): %m\n",
-              modeset_dev_->conn, errno);
-      return false;
+    for (auto& dev : modeset_devs_) {
+      if (!dev->client)
+        continue;
+      uint32_t fb_id = dev->client->GetFrameBuffer(dev->front_buffer);
+      dev->saved_crtc = drmModeGetCrtc(fd_, dev->crtc);
+      if (atomic_) {
+        if (!AtomicModeSetCrtc(dev.get(), fb_id))
+          return false;
+        continue;
+      }
+
+      int ret = drmModeSetCrtc(fd_, dev->crtc, fb_id, 0, 0, &dev->conn, 1,
+                               &dev->mode);
+      if (ret) {
+        fprintf(stderr, "cannot set CRTC for connector %u (%d): %m\n",
+                dev->conn, errno);
+        return false;
+      }
     }
     return true;
   }
 
-  bool PageFlip(uint32_t fb_id, void* user_data) {
-    int ret = drmModePageFlip(fd_, modeset_dev_->crtc, fb_id,
-                              DRM_MODE_PAGE_FLIP_EVENT, user_data);
-    if (ret) {
-      std::cout << "failed to queue page flip: " << std::strerror(errno)
-                << '\n';
+  bool IsExplicitFencingSupported() const {
+    if (!atomic_)
       return false;
+    for (auto& dev : modeset_devs_) {
+      if (!IsExplicitFencingSupported(dev.get()))
+        return false;
     }
     return true;
   }
 
+  bool PageFlip(size_t output,
+                uint32_t fb_id,
+                int in_fence_fd,
+                int* out_fence_fd) {
+    return PageFlip(modeset_devs_[output].get(), fb_id, {}, {}, in_fence_fd,
+                    out_fence_fd);
+  }
+
+  bool IsFormatSupported(size_t output, uint32_t format) const {
+    if (headless_)
+      return true;
+    const std::vector<uint32_t>& formats = modeset_devs_[output]->formats;
+    return formats.empty() ||
+           std::find(formats.begin(), formats.end(), format) != formats.end();
+  }
+
+  bool IsModifierSupported() const { return modifiers_supported_; }
+
+  std::vector<uint64_t> GetModifiers(size_t output, uint32_t format) const {
+    if (headless_)
+      return {};
+    return FindModifiers(modeset_devs_[output]->modifiers, format);
+  }
+
+  int AllocateOverlayPlane(size_t output, uint32_t format, uint64_t modifier) {
+    ModesetDev* dev = modeset_devs_[output].get();
+    for (size_t i = 0; i < overlay_planes_.size(); ++i) {
+      OverlayPlane& plane = overlay_planes_[i];
+      if (plane.owner || !(plane.possible_crtcs & (1 << dev->crtc_index)))
+        continue;
+      if (!IsOverlayFormatSupported(plane, format, modifier))
+        continue;
+      plane.owner = dev;
+      return i;
+    }
+    return -1;
+  }
+
+  void FreeOverlayPlane(int plane) { overlay_planes_[plane].owner = nullptr; }
+
+  // Only the kernel knows the scaling, size and bandwidth limits of a plane.
+  bool TestOverlay(size_t output, const Overlay& overlay) {
+    ModesetDev* dev = modeset_devs_[output].get();
+    assert(overlay_planes_[overlay.plane].owner == dev);
+    drmModeAtomicReq* req = drmModeAtomicAlloc();
+    bool ret = AddOverlayProperties(req, dev, overlay) &&
+               drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_TEST_ONLY,
+                                   nullptr) == 0;
+    drmModeAtomicFree(req);
+    return ret;
+  }
+
   /*
    * As a next step we need to find our available display devices. libdrm
    * provides
@@ -116,63 +213,210 @@ class DRMModesetter::Impl {
    * object for each connector+crtc+framebuffer pair that we successfully
    * initialized and push it into the global device-list.
    */
-  bool Initialize(const std::string& card) {
+  bool Initialize(const std::string& card, bool atomic) {
     fprintf(stdout, "using card: '%s': %m\n", card.data());
 
     /* open the DRM device */
     if (!DeviceOpen(card))
       return false;
 
+    if (atomic) {
+      /* atomic modesetting needs to see all planes, not only overlays */
+      if (drmSetClientCap(fd_, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) ||
+          drmSetClientCap(fd_, DRM_CLIENT_CAP_ATOMIC, 1)) {
+        fprintf(stderr, "no atomic modesetting support: %m\n");
+        return false;
+      }
+      atomic_ = true;
+
+      /* the planes list their modifiers in IN_FORMATS */
+      uint64_t cap = 0;
+      modifiers_supported_ =
+          !drmGetCap(fd_, DRM_CAP_ADDFB2_MODIFIERS, &cap) && cap;
+      printf("format modifiers: %s\n", modifiers_supported_ ? "on" : "off");
+    }
+
     /* prepare all connectors and CRTCs */
     if (!GetConnector())
       return false;
 
-    return true;
+    if (atomic_ && !GetOverlayPlanes())
+      return false;
+
+    return InitializeEventLoop();
   }
 
-  bool Run() {
-    fd_set fds;
-    drmEventContext evctx = {};
-    evctx.version = DRM_EVENT_CONTEXT_VERSION;
-    evctx.page_flip_handler = OnModesetPageFlipEvent;
-    bool is_running = true;
-
-    while (is_running) {
-      front_buffer_ ^= 1;
-      if (!PageFlip(client_->GetFrameBuffer(front_buffer_), this)) {
-        std::cout << "failed page flip.\n";
+  bool InitializeHeadless(const DRMModesetter::HeadlessConfig& config) {
+    if (config.width <= 0 || config.height <= 0 || config.refresh_rate < 0) {
+      fprintf(stderr, "invalid headless config: %dx%d@%d\n", config.width,
+              config.height, config.refresh_rate);
+      return false;
+    }
+    if (!config.render_node.empty()) {
+      fprintf(stdout, "using render node: '%s'\n",
+              config.render_node.data());
+      if (!DeviceOpen(config.render_node))
         return false;
-      }
+    }
 
-      page_flip_pending_ = true;
-      while (page_flip_pending_) {
-        FD_ZERO(&fds);
-        FD_SET(0, &fds);
-        FD_SET(GetFD(), &fds);
-        int ret = select(GetFD() + 1, &fds, nullptr, nullptr, nullptr);
-        if (ret < 0) {
-          std::cout << "select err: " << std::strerror(errno) << '\n';
-          return false;
-        } else if (ret == 0) {
-          fprintf(stderr, "select timeout!\n");
-          return false;
-        }
+    headless_ = true;
+    headless_size_ = {config.width, config.height};
+    modeset_devs_.emplace_back(new ModesetDev());
+    modeset_devs_.back()->impl = this;
+    if (config.refresh_rate)
+      headless_refresh_interval_ = 1000000 / config.refresh_rate;
+    if (!InitializeEventLoop())
+      return false;
 
-        if (FD_ISSET(0, &fds)) {
-          is_running = false;
-        }
-        if (FD_ISSET(GetFD(), &fds)) {
-          drmHandleEvent(GetFD(), &evctx);
-        }
-      }
-      if (FD_ISSET(0, &fds)) {
-        printf("exit due to user-input\n");
-      }
+    /* a fake VBlank completes the pending flip, if any */
+    if (headless_refresh_interval_ &&
+        loop_->AddTimer(headless_refresh_interval_, headless_refresh_interval_,
+                        [this](uint64_t expirations) {
+                          headless_sequence_ += expirations;
+                          DidFakePageFlips();
+                          MaybePageFlip();
+                        }) < 0) {
+      return false;
+    }
+    return true;
+  }
+
+  bool InitializeEventLoop() {
+    loop_ = EventLoop::Create();
+    if (!loop_)
+      return false;
+
+    evctx_.version = DRM_EVENT_CONTEXT_VERSION;
+    evctx_.page_flip_handler = OnModesetPageFlipEvent;
+    if (!headless_ && !loop_->AddFD(fd_, EPOLLIN, [this](uint32_t) {
+          drmHandleEvent(fd_, &evctx_);
+          MaybePageFlip();
+        })) {
+      return false;
+    }
+
+    wakeup_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeup_fd_ < 0) {
+      fprintf(stderr, "cannot create eventfd: %m\n");
+      return false;
+    }
+    if (!loop_->AddFD(wakeup_fd_, EPOLLIN, [this](uint32_t) {
+          /* just reset the counter and ask the client again */
+          uint64_t count;
+          if (read(wakeup_fd_, &count, sizeof(count)) < 0)
+            fprintf(stderr, "cannot read eventfd: %m\n");
+          /* without a refresh rate, a headless flip completes right away */
+          if (headless_ && !headless_refresh_interval_) {
+            headless_sequence_++;
+            DidFakePageFlips();
+          }
+          MaybePageFlip();
+        })) {
+      return false;
     }
+
     return true;
   }
 
+  EventLoop* GetEventLoop() { return loop_.get(); }
+
+  // eventfd is safe to write from any thread.
+  void Wakeup() {
+    uint64_t one = 1;
+    if (write(wakeup_fd_, &one, sizeof(one)) < 0)
+      fprintf(stderr, "cannot wake up the event loop: %m\n");
+  }
+
+  void SetWatchStdin(bool watch) { watch_stdin_ = watch; }
+
+  bool Run() {
+    is_running_ = true;
+    run_failed_ = false;
+
+    /* any input on stdin stops the demo */
+    bool watch_stdin =
+        watch_stdin_ && loop_->AddFD(0, EPOLLIN, [this](uint32_t) {
+          printf("exit due to user-input\n");
+          loop_->Remove(0);
+          Stop();
+        });
+
+    MaybePageFlip();
+    bool ret = loop_->Run();
+
+    if (watch_stdin)
+      loop_->Remove(0);
+    return ret && !run_failed_;
+  }
+
+  // Keep going until the last page flip lands, so that the buffers can be
+  // destroyed safely.
+  void Stop() {
+    is_running_ = false;
+    if (!IsPageFlipPending())
+      loop_->Quit();
+  }
+
  private:
+  typedef std::map<std::string, uint32_t> PropertyMap;
+  // format to the modifiers a plane can scan it out with
+  typedef std::map<uint32_t, std::vector<uint64_t>> ModifierMap;
+
+  struct ModesetDev {
+    // the display mode that we want to use
+    drmModeModeInfo mode;
+    // the connector ID that we want to use with this buffer
+    uint32_t conn;
+    // the crtc ID that we want to use with this connector
+    uint32_t crtc;
+    // the configuration of the crtc before we changed it. We use it so we can
+    // restore the same mode when we exit.
+    drmModeCrtc* saved_crtc = nullptr;
+
+    // Only for atomic modesetting.
+    // the primary plane that scans out the framebuffer on the crtc
+    uint32_t plane = 0;
+    // what |plane| can scan out
+    std::vector<uint32_t> formats;
+    // the bit of the crtc in possible_crtcs of planes
+    int crtc_index = -1;
+    // the property blob holding |mode|
+    uint32_t mode_blob_id = 0;
+    // property name to property ID of each object
+    PropertyMap conn_props;
+    PropertyMap crtc_props;
+    PropertyMap plane_props;
+    // of the primary plane; empty if the driver doesn't tell
+    ModifierMap modifiers;
+
+    // Every CRTC flips on its own VBlank, so a slow display never holds back
+    // a fast one.
+    DRMModesetter::Client* client = nullptr;
+    int front_buffer = 0;
+    int pending_buffer = -1;
+    // true when a page-flip is currently pending, that is, the kernel will
+    // flip buffers on the next vertical blank.
+    bool page_flip_pending = false;
+    // the VBlank counter of the last flip, widened from the 32 bits of the
+    // kernel
+    uint64_t sequence = 0;
+    // the overlay planes that the last flip turned on
+    std::vector<int> active_overlays;
+    DRMModesetter::Impl* impl = nullptr;
+  };
+
+  struct OverlayPlane {
+    uint32_t id = 0;
+    uint32_t possible_crtcs = 0;
+    std::vector<uint32_t> formats;
+    ModifierMap modifiers;
+    PropertyMap props;
+    // Some drivers fix the stacking order; then zpos is immutable.
+    bool zpos_mutable = false;
+    // the output that allocated the plane, or nullptr
+    ModesetDev* owner = nullptr;
+  };
+
   /*
    * When the linux kernel detects a graphics-card on your machine, it loads the
    * correct device driver (located in kernel-tree at ./drivers/gpu/drm/<xy>)
@@ -247,20 +491,21 @@ class DRMModesetter::Impl {
 
       /* check if a monitor is connected */
       if (conn->connection != DRM_MODE_CONNECTED) {
-        drmModeFreeConnector(conn);
         fprintf(stderr, "ignoring unused connector %u\n", conn->connector_id);
+        drmModeFreeConnector(conn);
         continue;
       }
 
       /* check if there is at least one valid mode */
       if (!conn->count_modes) {
-        drmModeFreeConnector(conn);
         fprintf(stderr, "no valid mode for connector %u\n", conn->connector_id);
+        drmModeFreeConnector(conn);
         continue;
       }
 
       /* create a device structure */
       std::unique_ptr<ModesetDev> dev(new ModesetDev());
+      dev->impl = this;
       dev->conn = conn->connector_id;
       dev->mode = conn->modes[0];
 
@@ -272,19 +517,28 @@ class DRMModesetter::Impl {
         continue;
       }
 
+      /* look up the plane and the property IDs for atomic commits */
+      if (atomic_ && !InitializeAtomic(res, dev.get())) {
+        fprintf(stderr, "cannot setup atomic modesetting for connector %u\n",
+                conn->connector_id);
+        drmModeFreeConnector(conn);
+        continue;
+      }
+
       /* free connector data and link device into global list */
+      printf("connector %u: %dx%d on CRTC %u\n", dev->conn,
+             dev->mode.hdisplay, dev->mode.vdisplay, dev->crtc);
       drmModeFreeConnector(conn);
-      modeset_dev_ = dev.get();
-      modeset_dev_list_.push_back(std::move(dev));
-
-      // FIXME(dshwang): GetConnector() can support multiple connector, but
-      // it makes page flip logic is so complicated. So use only one connector.
-      // Most embedded devices have only one monitor.
-      break;
+      modeset_devs_.push_back(std::move(dev));
     }
 
     /* free resources again */
     drmModeFreeResources(res);
+
+    if (modeset_devs_.empty()) {
+      fprintf(stderr, "no connected connector with a free CRTC\n");
+      return false;
+    }
     return true;
   }
 
@@ -316,19 +570,10 @@ class DRMModesetter::Impl {
     /* first try the currently conected encoder+crtc */
     if (conn->encoder_id) {
       drmModeEncoder* enc = drmModeGetEncoder(fd, conn->encoder_id);
-      if (enc && enc->crtc_id) {
-        uint32_t crtc = enc->crtc_id;
-        for (auto& dev : modeset_dev_list_) {
-          if (dev->crtc == crtc) {
-            break;
-          }
-        }
-
-        if (crtc >= 0) {
-          drmModeFreeEncoder(enc);
-          *crtc_out = crtc;
-          return true;
-        }
+      if (enc && enc->crtc_id && !IsCrtcUsed(enc->crtc_id)) {
+        *crtc_out = enc->crtc_id;
+        drmModeFreeEncoder(enc);
+        return true;
       }
       drmModeFreeEncoder(enc);
     }
@@ -353,18 +598,13 @@ class DRMModesetter::Impl {
 
         /* check that no other device already uses this CRTC */
         uint32_t crtc = res->crtcs[j];
-        for (auto& dev : modeset_dev_list_) {
-          if (dev->crtc == crtc) {
-            break;
-          }
-        }
+        if (IsCrtcUsed(crtc))
+          continue;
 
         /* we have found a CRTC, so save it and return */
-        if (crtc >= 0) {
-          drmModeFreeEncoder(enc);
-          *crtc_out = crtc;
-          return true;
-        }
+        drmModeFreeEncoder(enc);
+        *crtc_out = crtc;
+        return true;
       }
 
       drmModeFreeEncoder(enc);
@@ -375,50 +615,637 @@ class DRMModesetter::Impl {
     return false;
   }
 
+  bool IsCrtcUsed(uint32_t crtc) const {
+    for (auto& dev : modeset_devs_) {
+      if (dev->crtc == crtc)
+        return true;
+    }
+    return false;
+  }
+
+  bool IsPlaneUsed(uint32_t plane) const {
+    for (auto& dev : modeset_devs_) {
+      if (dev->plane == plane)
+        return true;
+    }
+    return false;
+  }
+
+  /*
+   * Atomic modesetting doesn't have dedicated ioctls for each operation.
+   * Instead, the state of every KMS object is a set of properties, and a
+   * commit changes any number of properties of any number of objects at once.
+   * The kernel either applies the whole request or nothing, and it can check
+   * a request without applying it (DRM_MODE_ATOMIC_TEST_ONLY).
+   *
+   * Properties are referenced by IDs that differ between drivers, so we look
+   * them up by name for the connector, the CRTC and the primary plane once.
+   * Unlike the legacy API, the scanout buffer is attached to a plane rather
+   * than to the CRTC, so we also need to find the primary plane of the CRTC.
+   */
+  bool InitializeAtomic(drmModeRes* res, ModesetDev* dev) {
+    if (!FindPrimaryPlane(res, dev))
+      return false;
+
+    if (!GetProperties(dev->conn, DRM_MODE_OBJECT_CONNECTOR,
+                       &dev->conn_props) ||
+        !GetProperties(dev->crtc, DRM_MODE_OBJECT_CRTC, &dev->crtc_props) ||
+        !GetProperties(dev->plane, DRM_MODE_OBJECT_PLANE, &dev->plane_props)) {
+      return false;
+    }
+    GetModifiers(dev->plane, &dev->modifiers);
+    return true;
+  }
+
+  bool FindPrimaryPlane(drmModeRes* res, ModesetDev* dev) {
+    int crtc_index = -1;
+    for (int i = 0; i < res->count_crtcs; ++i) {
+      if (res->crtcs[i] == dev->crtc)
+        crtc_index = i;
+    }
+    assert(crtc_index != -1);
+    dev->crtc_index = crtc_index;
+
+    drmModePlaneRes* plane_res = drmModeGetPlaneResources(fd_);
+    if (!plane_res) {
+      fprintf(stderr, "cannot retrieve DRM plane resources (%d): %m\n", errno);
+      return false;
+    }
+
+    for (uint32_t i = 0; i < plane_res->count_planes && !dev->plane; ++i) {
+      drmModePlane* plane = drmModeGetPlane(fd_, plane_res->planes[i]);
+      if (!plane)
+        continue;
+
+      /* a plane scans out for one CRTC at a time */
+      uint64_t type = 0;
+      if ((plane->possible_crtcs & (1 << crtc_index)) &&
+          !IsPlaneUsed(plane->plane_id) &&
+          GetPropertyValue(plane->plane_id, DRM_MODE_OBJECT_PLANE, "type",
+                           &type) &&
+          type == DRM_PLANE_TYPE_PRIMARY) {
+        dev->plane = plane->plane_id;
+        dev->formats.assign(plane->formats,
+                            plane->formats + plane->count_formats);
+      }
+      drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(plane_res);
+
+    if (!dev->plane) {
+      fprintf(stderr, "cannot find primary plane for CRTC %u\n", dev->crtc);
+      return false;
+    }
+    return true;
+  }
+
+  /*
+   * Overlay planes scan out buffers on top of the primary plane, and the
+   * display controller blends them on the fly. A buffer that goes on an
+   * overlay never has to be drawn into the framebuffer by the GPU. Which
+   * CRTCs and formats each plane supports is fixed, so we read it once.
+   */
+  bool GetOverlayPlanes() {
+    drmModePlaneRes* plane_res = drmModeGetPlaneResources(fd_);
+    if (!plane_res) {
+      fprintf(stderr, "cannot retrieve DRM plane resources (%d): %m\n", errno);
+      return false;
+    }
+
+    for (uint32_t i = 0; i < plane_res->count_planes; ++i) {
+      drmModePlane* plane = drmModeGetPlane(fd_, plane_res->planes[i]);
+      if (!plane)
+        continue;
+
+      uint64_t type = 0;
+      OverlayPlane overlay;
+      if (GetPropertyValue(plane->plane_id, DRM_MODE_OBJECT_PLANE, "type",
+                           &type) &&
+          type == DRM_PLANE_TYPE_OVERLAY &&
+          GetProperties(plane->plane_id, DRM_MODE_OBJECT_PLANE,
+                        &overlay.props)) {
+        overlay.id = plane->plane_id;
+        overlay.possible_crtcs = plane->possible_crtcs;
+        overlay.formats.assign(plane->formats,
+                               plane->formats + plane->count_formats);
+        overlay.zpos_mutable = IsPropertyMutable(overlay.props, "zpos");
+        GetModifiers(overlay.id, &overlay.modifiers);
+        overlay_planes_.push_back(std::move(overlay));
+      }
+      drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(plane_res);
+
+    printf("overlay planes: %zu\n", overlay_planes_.size());
+    return true;
+  }
+
+  /*
+   * Tiled and compressed layouts, such as Intel Y-tiling with CCS or ARM
+   * AFBC, need much less memory bandwidth than linear ones, but a plane
+   * scans out only the layouts it knows. IN_FORMATS is a blob listing them
+   * as format modifiers: a table of formats, and for each modifier a bitmask
+   * over a window of 64 formats starting at |offset|.
+   */
+  void GetModifiers(uint32_t plane_id, ModifierMap* modifiers) {
+    uint64_t blob_id = 0;
+    if (!modifiers_supported_ ||
+        !GetPropertyValue(plane_id, DRM_MODE_OBJECT_PLANE, "IN_FORMATS",
+                          &blob_id) ||
+        !blob_id) {
+      return;
+    }
+    drmModePropertyBlobRes* blob = drmModeGetPropertyBlob(fd_, blob_id);
+    if (!blob)
+      return;
+
+    // The blob comes from the driver, so don't read past it.
+    const char* data = static_cast<const char*>(blob->data);
+    const drm_format_modifier_blob* header =
+        reinterpret_cast<const drm_format_modifier_blob*>(data);
+    if (blob->length < sizeof(*header) ||
+        header->version < FORMAT_BLOB_CURRENT ||
+        !FitsInBlob(blob->length, header->formats_offset,
+                    header->count_formats, sizeof(uint32_t)) ||
+        !FitsInBlob(blob->length, header->modifiers_offset,
+                    header->count_modifiers, sizeof(drm_format_modifier))) {
+      fprintf(stderr, "malformed IN_FORMATS blob of plane %u\n", plane_id);
+      drmModeFreePropertyBlob(blob);
+      return;
+    }
+    const uint32_t* formats =
+        reinterpret_cast<const uint32_t*>(data + header->formats_offset);
+    const drm_format_modifier* entries =
+        reinterpret_cast<const drm_format_modifier*>(
+            data + header->modifiers_offset);
+    for (uint32_t i = 0; i < header->count_modifiers; ++i) {
+      const drm_format_modifier& entry = entries[i];
+      for (uint32_t bit = 0; bit < 64; ++bit) {
+        uint32_t index = entry.offset + bit;
+        if ((entry.formats & (uint64_t(1) << bit)) &&
+            index < header->count_formats) {
+          (*modifiers)[formats[index]].push_back(entry.modifier);
+        }
+      }
+    }
+    drmModeFreePropertyBlob(blob);
+  }
+
+  static bool FitsInBlob(uint32_t length,
+                         uint32_t offset,
+                         uint32_t count,
+                         size_t size) {
+    return offset <= length && count <= (length - offset) / size;
+  }
+
+  static std::vector<uint64_t> FindModifiers(const ModifierMap& modifiers,
+                                             uint32_t format) {
+    auto it = modifiers.find(format);
+    if (it == modifiers.end())
+      return {};
+    return it->second;
+  }
+
+  // DRM_FORMAT_MOD_INVALID means the driver picks the layout implicitly.
+  static bool IsOverlayFormatSupported(const OverlayPlane& plane,
+                                       uint32_t format,
+                                       uint64_t modifier) {
+    bool found = false;
+    for (uint32_t plane_format : plane.formats)
+      found |= plane_format == format;
+    if (!found || modifier == DRM_FORMAT_MOD_INVALID ||
+        plane.modifiers.empty()) {
+      return found;
+    }
+    for (uint64_t plane_modifier : FindModifiers(plane.modifiers, format)) {
+      if (plane_modifier == modifier)
+        return true;
+    }
+    return false;
+  }
+
+  bool IsPropertyMutable(const PropertyMap& props, const char* name) {
+    auto it = props.find(name);
+    if (it == props.end())
+      return false;
+    drmModePropertyRes* prop = drmModeGetProperty(fd_, it->second);
+    if (!prop)
+      return false;
+    bool is_mutable = !(prop->flags & DRM_MODE_PROP_IMMUTABLE);
+    drmModeFreeProperty(prop);
+    return is_mutable;
+  }
+
+  bool GetProperties(uint32_t object_id,
+                     uint32_t object_type,
+                     PropertyMap* props) {
+    drmModeObjectProperties* obj_props =
+        drmModeObjectGetProperties(fd_, object_id, object_type);
+    if (!obj_props) {
+      fprintf(stderr, "cannot get properties of object %u: %m\n", object_id);
+      return false;
+    }
+
+    for (uint32_t i = 0; i < obj_props->count_props; ++i) {
+      drmModePropertyRes* prop = drmModeGetProperty(fd_, obj_props->props[i]);
+      if (!prop)
+        continue;
+      (*props)[prop->name] = prop->prop_id;
+      drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(obj_props);
+    return true;
+  }
+
+  bool GetPropertyValue(uint32_t object_id,
+                        uint32_t object_type,
+                        const char* name,
+                        uint64_t* value) {
+    drmModeObjectProperties* obj_props =
+        drmModeObjectGetProperties(fd_, object_id, object_type);
+    if (!obj_props)
+      return false;
+
+    bool found = false;
+    for (uint32_t i = 0; i < obj_props->count_props && !found; ++i) {
+      drmModePropertyRes* prop = drmModeGetProperty(fd_, obj_props->props[i]);
+      if (!prop)
+        continue;
+      if (!strcmp(prop->name, name)) {
+        *value = obj_props->prop_values[i];
+        found = true;
+      }
+      drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(obj_props);
+    return found;
+  }
+
+  bool AddProperty(drmModeAtomicReq* req,
+                   uint32_t object_id,
+                   const PropertyMap& props,
+                   const char* name,
+                   uint64_t value) {
+    auto it = props.find(name);
+    if (it == props.end()) {
+      fprintf(stderr, "no %s property on object %u\n", name, object_id);
+      return false;
+    }
+    if (drmModeAtomicAddProperty(req, object_id, it->second, value) < 0) {
+      fprintf(stderr, "cannot add %s property on object %u\n", name,
+              object_id);
+      return false;
+    }
+    return true;
+  }
+
+  // The primary plane covers the whole CRTC.
+  bool AddPlaneProperties(drmModeAtomicReq* req,
+                          ModesetDev* dev,
+                          uint32_t fb_id) {
+    const PropertyMap& props = dev->plane_props;
+    uint32_t width = dev->mode.hdisplay;
+    uint32_t height = dev->mode.vdisplay;
+    /* source coordinates are 16.16 fixed point */
+    return AddProperty(req, dev->plane, props, "FB_ID", fb_id) &&
+           AddProperty(req, dev->plane, props, "CRTC_ID", dev->crtc) &&
+           AddProperty(req, dev->plane, props, "SRC_X", 0) &&
+           AddProperty(req, dev->plane, props, "SRC_Y", 0) &&
+           AddProperty(req, dev->plane, props, "SRC_W", width << 16) &&
+           AddProperty(req, dev->plane, props, "SRC_H", height << 16) &&
+           AddProperty(req, dev->plane, props, "CRTC_X", 0) &&
+           AddProperty(req, dev->plane, props, "CRTC_Y", 0) &&
+           AddProperty(req, dev->plane, props, "CRTC_W", width) &&
+           AddProperty(req, dev->plane, props, "CRTC_H", height);
+  }
+
+  bool AddOverlayProperties(drmModeAtomicReq* req,
+                            ModesetDev* dev,
+                            const Overlay& overlay) {
+    const OverlayPlane& plane = overlay_planes_[overlay.plane];
+    const PropertyMap& props = plane.props;
+    const Rect& src = overlay.src;
+    const Rect& dst = overlay.dst;
+    /* source coordinates are 16.16 fixed point */
+    bool ret =
+        AddProperty(req, plane.id, props, "FB_ID", overlay.fb_id) &&
+        AddProperty(req, plane.id, props, "CRTC_ID", dev->crtc) &&
+        AddProperty(req, plane.id, props, "SRC_X", uint64_t(src.x) << 16) &&
+        AddProperty(req, plane.id, props, "SRC_Y", uint64_t(src.y) << 16) &&
+        AddProperty(req, plane.id, props, "SRC_W",
+                    uint64_t(src.width) << 16) &&
+        AddProperty(req, plane.id, props, "SRC_H",
+                    uint64_t(src.height) << 16) &&
+        /* CRTC_X and CRTC_Y are signed, so a plane can hang off the edge */
+        AddProperty(req, plane.id, props, "CRTC_X", int64_t(dst.x)) &&
+        AddProperty(req, plane.id, props, "CRTC_Y", int64_t(dst.y)) &&
+        AddProperty(req, plane.id, props, "CRTC_W", dst.width) &&
+        AddProperty(req, plane.id, props, "CRTC_H", dst.height);
+    if (ret && plane.zpos_mutable)
+      ret = AddProperty(req, plane.id, props, "zpos", overlay.zpos);
+    return ret;
+  }
+
+  // Turns on |overlays| and turns off the ones the last flip showed but
+  // |overlays| doesn't have.
+  bool AddOverlays(drmModeAtomicReq* req,
+                   ModesetDev* dev,
+                   const std::vector<Overlay>& overlays) {
+    for (const Overlay& overlay : overlays) {
+      if (!AddOverlayProperties(req, dev, overlay))
+        return false;
+    }
+    for (int index : dev->active_overlays) {
+      bool shown = false;
+      for (const Overlay& overlay : overlays)
+        shown |= overlay.plane == index;
+      if (shown)
+        continue;
+      const OverlayPlane& plane = overlay_planes_[index];
+      if (!AddProperty(req, plane.id, plane.props, "FB_ID", 0) ||
+          !AddProperty(req, plane.id, plane.props, "CRTC_ID", 0)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool AtomicCommit(drmModeAtomicReq* req, uint32_t flags, void* user_data) {
+    int ret = drmModeAtomicCommit(fd_, req, flags, user_data);
+    if (ret) {
+      fprintf(stderr, "%satomic commit failed: %m\n",
+              (flags & DRM_MODE_ATOMIC_TEST_ONLY) ? "test-only " : "");
+      return false;
+    }
+    return true;
+  }
+
+  bool AtomicModeSetCrtc(ModesetDev* dev, uint32_t fb_id) {
+    if (drmModeCreatePropertyBlob(fd_, &dev->mode, sizeof(dev->mode),
+                                  &dev->mode_blob_id)) {
+      fprintf(stderr, "cannot create mode blob: %m\n");
+      return false;
+    }
+
+    drmModeAtomicReq* req = drmModeAtomicAlloc();
+    bool ret =
+        AddProperty(req, dev->conn, dev->conn_props, "CRTC_ID", dev->crtc) &&
+        AddProperty(req, dev->crtc, dev->crtc_props, "MODE_ID",
+                    dev->mode_blob_id) &&
+        AddProperty(req, dev->crtc, dev->crtc_props, "ACTIVE", 1) &&
+        AddPlaneProperties(req, dev, fb_id);
+
+    /* make sure the driver accepts the configuration before applying it */
+    uint32_t flags = DRM_MODE_ATOMIC_ALLOW_MODESET;
+    ret = ret &&
+          AtomicCommit(req, flags | DRM_MODE_ATOMIC_TEST_ONLY, nullptr) &&
+          AtomicCommit(req, flags, nullptr);
+    drmModeAtomicFree(req);
+    if (!ret) {
+      fprintf(stderr, "cannot set CRTC for connector %u\n", dev->conn);
+      return false;
+    }
+    return true;
+  }
+
+  // Nonblocking commit; the flip event arrives through drmHandleEvent() like
+  // the legacy page flip.
+  // With explicit fencing, the kernel waits for the in-fence instead of us,
+  // and the out-fence signals when this commit takes over the screen, which
+  // is exactly when the previous framebuffer is released.
+  bool AtomicPageFlip(ModesetDev* dev,
+                      uint32_t fb_id,
+                      const std::vector<Overlay>& overlays,
+                      const std::vector<Rect>& damage,
+                      int in_fence_fd,
+                      int* out_fence_fd) {
+    bool explicit_fencing = IsExplicitFencingSupported(dev);
+    /* the kernel writes a 32-bit fd to OUT_FENCE_PTR */
+    int32_t out_fence = -1;
+
+    drmModeAtomicReq* req = drmModeAtomicAlloc();
+    bool ret = AddPlaneProperties(req, dev, fb_id) &&
+               AddOverlays(req, dev, overlays);
+    uint32_t damage_blob_id = CreateDamageBlob(dev, damage);
+    if (ret && damage_blob_id) {
+      ret = AddProperty(req, dev->plane, dev->plane_props, "FB_DAMAGE_CLIPS",
+                        damage_blob_id);
+    }
+    if (ret && explicit_fencing && in_fence_fd >= 0) {
+      ret = AddProperty(req, dev->plane, dev->plane_props, "IN_FENCE_FD",
+                        in_fence_fd);
+    }
+    if (ret && explicit_fencing && out_fence_fd) {
+      ret = AddProperty(req, dev->crtc, dev->crtc_props, "OUT_FENCE_PTR",
+                        reinterpret_cast<uint64_t>(&out_fence));
+    }
+    ret = ret && AtomicCommit(req, DRM_MODE_ATOMIC_NONBLOCK |
+                                       DRM_MODE_PAGE_FLIP_EVENT,
+                              dev);
+    drmModeAtomicFree(req);
+    /* the commit holds its own copy of the clips */
+    if (damage_blob_id)
+      drmModeDestroyPropertyBlob(fd_, damage_blob_id);
+
+    /* the commit holds its own reference to the in-fence */
+    if (in_fence_fd >= 0)
+      close(in_fence_fd);
+
+    if (!ret) {
+      std::cout << "failed to queue atomic page flip.\n";
+      return false;
+    }
+    if (out_fence_fd)
+      *out_fence_fd = out_fence;
+    dev->active_overlays.clear();
+    for (const Overlay& overlay : overlays)
+      dev->active_overlays.push_back(overlay.plane);
+    return true;
+  }
+
+  // Returns 0 if the primary plane can't take damage clips, which is the
+  // same as all of it damaged.
+  uint32_t CreateDamageBlob(const ModesetDev* dev,
+                            const std::vector<Rect>& damage) {
+    if (damage.empty() || !dev->plane_props.count("FB_DAMAGE_CLIPS"))
+      return 0;
+    std::vector<drm_mode_rect> clips;
+    for (const Rect& rect : damage) {
+      drm_mode_rect clip;
+      clip.x1 = rect.x;
+      clip.y1 = rect.y;
+      clip.x2 = rect.x + rect.width;
+      clip.y2 = rect.y + rect.height;
+      clips.push_back(clip);
+    }
+    uint32_t blob_id = 0;
+    if (drmModeCreatePropertyBlob(fd_, clips.data(),
+                                  clips.size() * sizeof(drm_mode_rect),
+                                  &blob_id)) {
+      fprintf(stderr, "cannot create damage blob: %m\n");
+      return 0;
+    }
+    return blob_id;
+  }
+
+  bool IsExplicitFencingSupported(const ModesetDev* dev) const {
+    return atomic_ && dev->plane_props.count("IN_FENCE_FD") &&
+           dev->crtc_props.count("OUT_FENCE_PTR");
+  }
+
+  // The flip event comes back with |dev|, so every CRTC completes its own
+  // flips. Only atomic modesetting has overlay planes.
+  bool PageFlip(ModesetDev* dev,
+                uint32_t fb_id,
+                const std::vector<Overlay>& overlays,
+                const std::vector<Rect>& damage,
+                int in_fence_fd,
+                int* out_fence_fd) {
+    if (out_fence_fd)
+      *out_fence_fd = -1;
+    if (headless_)
+      return FakePageFlip(in_fence_fd);
+    if (atomic_) {
+      return AtomicPageFlip(dev, fb_id, overlays, damage, in_fence_fd,
+                            out_fence_fd);
+    }
+
+    /* the legacy API can't wait for a fence, so the caller must have waited */
+    if (in_fence_fd >= 0)
+      close(in_fence_fd);
+
+    int ret = drmModePageFlip(fd_, dev->crtc, fb_id, DRM_MODE_PAGE_FLIP_EVENT,
+                              dev);
+    if (ret) {
+      std::cout << "failed to queue page flip: " << std::strerror(errno)
+                << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  bool IsPageFlipPending() const {
+    for (auto& dev : modeset_devs_) {
+      if (dev->page_flip_pending)
+        return true;
+    }
+    return false;
+  }
+
+  void MaybePageFlip() {
+    for (auto& dev : modeset_devs_)
+      MaybePageFlip(dev.get());
+  }
+
+  // Flips the next queued buffer unless a flip is already pending on the
+  // CRTC.
+  void MaybePageFlip(ModesetDev* dev) {
+    if (!is_running_ || !dev->client || dev->page_flip_pending)
+      return;
+
+    DRMModesetter::Client* client = dev->client;
+    int buffer = client->GetQueuedBuffer();
+    if (buffer < 0)
+      return;
+
+    int release_fence_fd = -1;
+    if (!PageFlip(dev, client->GetFrameBuffer(buffer),
+                  client->TakeOverlays(buffer), client->TakeDamage(buffer),
+                  client->TakeRenderFence(buffer), &release_fence_fd)) {
+      std::cout << "failed page flip.\n";
+      run_failed_ = true;
+      Stop();
+      return;
+    }
+    dev->pending_buffer = buffer;
+    dev->page_flip_pending = true;
+    client->DidCommitPageFlip(release_fence_fd);
+  }
+
   // As soon as page flip, notify the client to draw the next frame.
-  void DidPageFlip(unsigned int sec, unsigned int usec) {
-    page_flip_pending_ = false;
-    client_->DidPageFlip(front_buffer_, sec, usec);
+  void DidPageFlip(ModesetDev* dev,
+                   unsigned int frame,
+                   unsigned int sec,
+                   unsigned int usec) {
+    dev->page_flip_pending = false;
+    dev->front_buffer = dev->pending_buffer;
+    dev->pending_buffer = -1;
+    /* the difference of the low 32 bits survives their wrap around */
+    dev->sequence += uint32_t(frame - uint32_t(dev->sequence));
+    dev->client->DidPageFlip(dev->front_buffer, dev->sequence,
+                             sec * 1000000000ull + usec * 1000ull);
+    if (!is_running_ && !IsPageFlipPending())
+      loop_->Quit();
+  }
+
+  // Nothing to show, so the flip only has to wait for the rendering.
+  bool FakePageFlip(int in_fence_fd) {
+    if (in_fence_fd >= 0) {
+      pollfd fds = {in_fence_fd, POLLIN, 0};
+      poll(&fds, 1, -1);
+      close(in_fence_fd);
+    }
+    /* the loop completes the flip, as the kernel event would */
+    if (!headless_refresh_interval_)
+      Wakeup();
+    return true;
   }
 
+  void DidFakePageFlips() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (auto& dev : modeset_devs_) {
+      if (dev->page_flip_pending)
+        DidPageFlip(dev.get(), headless_sequence_, now.tv_sec,
+                    now.tv_nsec / 1000);
+    }
+  }
+
+  // |data| is the ModesetDev of the CRTC that flipped.
   static void OnModesetPageFlipEvent(int fd,
                                      unsigned int frame,
                                      unsigned int sec,
                                      unsigned int usec,
                                      void* data) {
-    DRMModesetter::Impl* self = static_cast<DRMModesetter::Impl*>(data);
-    self->DidPageFlip(sec, usec);
+    ModesetDev* dev = static_cast<ModesetDev*>(data);
+    dev->impl->DidPageFlip(dev, frame, sec, usec);
   }
 
-  struct ModesetDev {
-    // the display mode that we want to use
-    drmModeModeInfo mode;
-    // the connector ID that we want to use with this buffer
-    uint32_t conn;
-    // the crtc ID that we want to use with this connector
-    uint32_t crtc;
-    // the configuration of the crtc before we changed it. We use it so we can
-    // restore the same mode when we exit.
-    drmModeCrtc* saved_crtc = nullptr;
-  };
-
   int fd_ = -1;
-  unsigned int front_buffer_ = 0;
-  DRMModesetter::Client* client_ = nullptr;
-  std::list<std::unique_ptr<ModesetDev>> modeset_dev_list_;
-  // Use the first modeset device.
-  ModesetDev* modeset_dev_ = nullptr;
-
-  // return true when a page-flip is currently pending, that is, the kernel will
-  // flip buffers on the next vertical blank.
-  bool page_flip_pending_ = false;
+  bool headless_ = false;
+  Size headless_size_ = {};
+  uint64_t headless_refresh_interval_ = 0;
+  uint64_t headless_sequence_ = 0;
+  std::unique_ptr<EventLoop> loop_;
+  drmEventContext evctx_ = {};
+  // lets other threads wake up the loop
+  int wakeup_fd_ = -1;
+  bool is_running_ = false;
+  bool run_failed_ = false;
+  bool watch_stdin_ = true;
+  bool atomic_ = false;
+  // DRM_CAP_ADDFB2_MODIFIERS; only looked up with |atomic_|
+  bool modifiers_supported_ = false;
+  // One per output, in the order of the connectors.
+  std::vector<std::unique_ptr<ModesetDev>> modeset_devs_;
+  // Only for atomic modesetting.
+  std::vector<OverlayPlane> overlay_planes_;
 };
 
 // static
 std::unique_ptr<DRMModesetter> DRMModesetter::Create(const std::string& card,
                                                      bool atomic) {
   std::unique_ptr<DRMModesetter> drm(new DRMModesetter());
-  if (drm->Initialize(card))
+  if (drm->Initialize(card, atomic))
+    return drm;
+  return nullptr;
+}
+
+// static
+std::unique_ptr<DRMModesetter> DRMModesetter::CreateHeadless(
+    const HeadlessConfig& config) {
+  std::unique_ptr<DRMModesetter> drm(new DRMModesetter());
+  if (drm->InitializeHeadless(config))
     return drm;
   return nullptr;
 }
@@ -427,33 +1254,112 @@ DRMModesetter::DRMModesetter() {}
 
 DRMModesetter::~DRMModesetter() {}
 
-bool DRMModesetter::Initialize(const std::string& card) {
+bool DRMModesetter::Initialize(const std::string& card, bool atomic) {
   impl_.reset(new Impl());
-  return impl_->Initialize(card);
+  return impl_->Initialize(card, atomic);
+}
+
+bool DRMModesetter::InitializeHeadless(const HeadlessConfig& config) {
+  impl_.reset(new Impl());
+  return impl_->InitializeHeadless(config);
 }
 
 void DRMModesetter::SetClient(DRMModesetter::Client* client) {
-  impl_->SetClient(client);
+  impl_->SetClient(0, client);
+}
+
+void DRMModesetter::SetClient(size_t output, DRMModesetter::Client* client) {
+  impl_->SetClient(output, client);
 }
 
 int DRMModesetter::GetFD() const {
   return impl_->GetFD();
 }
 
+bool DRMModesetter::IsHeadless() const {
+  return impl_->IsHeadless();
+}
+
+size_t DRMModesetter::GetOutputCount() const {
+  return impl_->GetOutputCount();
+}
+
 DRMModesetter::Size DRMModesetter::GetDisplaySize() const {
-  return impl_->GetDisplaySize();
+  return impl_->GetDisplaySize(0);
+}
+
+DRMModesetter::Size DRMModesetter::GetDisplaySize(size_t output) const {
+  return impl_->GetDisplaySize(output);
+}
+
+uint64_t DRMModesetter::GetRefreshInterval() const {
+  return impl_->GetRefreshInterval(0);
+}
+
+uint64_t DRMModesetter::GetRefreshInterval(size_t output) const {
+  return impl_->GetRefreshInterval(output);
 }
 
 bool DRMModesetter::ModeSetCrtc() {
   return impl_->ModeSetCrtc();
 }
 
-bool DRMModesetter::PageFlip(uint32_t fb_id, void* user_data) {
-  return impl_->PageFlip(fb_id, user_data);
+bool DRMModesetter::IsExplicitFencingSupported() const {
+  return impl_->IsExplicitFencingSupported();
+}
+
+bool DRMModesetter::PageFlip(size_t output,
+                             uint32_t fb_id,
+                             int in_fence_fd,
+                             int* out_fence_fd) {
+  return impl_->PageFlip(output, fb_id, in_fence_fd, out_fence_fd);
+}
+
+bool DRMModesetter::IsFormatSupported(size_t output, uint32_t format) const {
+  return impl_->IsFormatSupported(output, format);
+}
+
+bool DRMModesetter::IsModifierSupported() const {
+  return impl_->IsModifierSupported();
+}
+
+std::vector<uint64_t> DRMModesetter::GetModifiers(size_t output,
+                                                  uint32_t format) const {
+  return impl_->GetModifiers(output, format);
+}
+
+int DRMModesetter::AllocateOverlayPlane(size_t output,
+                                        uint32_t format,
+                                        uint64_t modifier) {
+  return impl_->AllocateOverlayPlane(output, format, modifier);
+}
+
+void DRMModesetter::FreeOverlayPlane(int plane) {
+  impl_->FreeOverlayPlane(plane);
+}
+
+bool DRMModesetter::TestOverlay(size_t output, const Overlay& overlay) {
+  return impl_->TestOverlay(output, overlay);
 }
 
 bool DRMModesetter::Run() {
   return impl_->Run();
 }
 
+void DRMModesetter::SetWatchStdin(bool watch) {
+  impl_->SetWatchStdin(watch);
+}
+
+void DRMModesetter::Stop() {
+  impl_->Stop();
+}
+
+EventLoop* DRMModesetter::GetEventLoop() {
+  return impl_->GetEventLoop();
+}
+
+void DRMModesetter::Wakeup() {
+  impl_->Wakeup();
+}
+
 }  // namespace ged
@@ -24,52 +24,188 @@
 #ifndef GED_DRM_MODESETTER_H_
 #define GED_DRM_MODESETTER_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ged {
 
+class EventLoop;
+
 /*
  * DRMModesetter abstracts the DRM modesetting API. It plays a role of
  * initializing DRM connection, crtc, and encoder. It provides API to handle
  * page-flips along with VBlank interval.
+ * With |atomic|, it uses the atomic modesetting API instead of the legacy
+ * drmModeSetCrtc() and drmModePageFlip().
+ *
+ * Every connected connector is an output with its own CRTC and its own
+ * client. Outputs flip independently on their own VBlanks, so displays with
+ * different refresh rates don't throttle each other.
+ *
+ * With atomic modesetting, clients can also put buffers on overlay planes,
+ * which the display controller blends over the framebuffer without the GPU.
+ *
+ * CreateHeadless() makes one that shows nothing. Page flips complete on a
+ * timer at the configured refresh rate, or right away if it's 0, so the
+ * rendering pipeline can run and be measured without a display.
  */
 class DRMModesetter {
  public:
+  struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+
+  // A buffer to scan out on an overlay plane.
+  struct Overlay {
+    // from AllocateOverlayPlane()
+    int plane;
+    uint32_t fb_id;
+    // the part of |fb_id| to show
+    Rect src;
+    // where on the display; it's scaled if the sizes differ from |src|
+    Rect dst;
+    // the stacking order, if the plane lets it be changed; the primary plane
+    // is usually 0
+    int zpos;
+  };
+
   class Client {
    public:
     virtual ~Client() = default;
 
+    // |front_buffer| is on the screen now, since the VBlank number
+    // |sequence| at |nsec| of CLOCK_MONOTONIC. Headless counts the fake
+    // VBlanks, or the flips if there are none.
     virtual void DidPageFlip(int front_buffer,
-                             unsigned int sec,
-                             unsigned int usec) = 0;
+                             uint64_t sequence,
+                             uint64_t nsec) = 0;
     virtual uint32_t GetFrameBuffer(int front_buffer) const = 0;
+    // Returns the next buffer to flip, or -1 if nothing is ready yet.
+    virtual int GetQueuedBuffer() = 0;
+    // Returns a sync_file fd that signals when rendering into |buffer| is
+    // done, or -1. The ownership of the fd moves to the caller.
+    virtual int TakeRenderFence(int buffer) = 0;
+    // The overlays to show together with |buffer|. An overlay plane that
+    // isn't in the list is turned off by the flip.
+    virtual std::vector<Overlay> TakeOverlays(int buffer) { return {}; }
+    // What differs between |buffer| and the buffer on the screen before it.
+    // If the primary plane has FB_DAMAGE_CLIPS, the display then fetches
+    // only that. Empty means all of it.
+    virtual std::vector<Rect> TakeDamage(int buffer) { return {}; }
+    // The flip to the queued buffer is committed. With explicit fencing, the
+    // buffer on the screen can be reused as soon as |release_fence_fd|
+    // signals, even before DidPageFlip(). Otherwise it's -1. The ownership of
+    // the fd moves to the client.
+    virtual void DidCommitPageFlip(int release_fence_fd) = 0;
   };
 
   static std::unique_ptr<DRMModesetter> Create(const std::string& card,
                                                bool atomic);
 
+  struct HeadlessConfig {
+    // A render node such as /dev/dri/renderD128 to allocate buffers from. If
+    // it's empty, GetFD() returns -1 and clients render without GBM.
+    std::string render_node;
+    int width = 1280;
+    int height = 720;
+    // 0 means uncapped.
+    int refresh_rate = 60;
+  };
+  static std::unique_ptr<DRMModesetter> CreateHeadless(
+      const HeadlessConfig& config);
+
   ~DRMModesetter();
   DRMModesetter(const DRMModesetter&) = delete;
   void operator=(const DRMModesetter&) = delete;
 
+  // The versions without |output| are for the output 0. An output without a
+  // client stays as it is.
   void SetClient(Client* client);
+  void SetClient(size_t output, Client* client);
   int GetFD() const;
+  bool IsHeadless() const;
+
+  // At least 1. Headless has exactly 1.
+  size_t GetOutputCount() const;
 
   struct Size {
     int width;
     int height;
   };
   Size GetDisplaySize() const;
+  Size GetDisplaySize(size_t output) const;
+  // The VBlank period of the mode in microseconds, or 0 if it's unknown.
+  uint64_t GetRefreshInterval() const;
+  uint64_t GetRefreshInterval(size_t output) const;
 
+  // Shows the buffer 0 of the client on every output.
   bool ModeSetCrtc();
-  bool PageFlip(uint32_t fb_id, void* user_data);
+
+  // True if PageFlip() can take an in-fence and give back an out-fence on
+  // every output. It needs atomic modesetting with IN_FENCE_FD and
+  // OUT_FENCE_PTR.
+  bool IsExplicitFencingSupported() const;
+
+  // The display waits for |in_fence_fd| before scanning out |fb_id|, unless it
+  // is -1. The modesetter takes the ownership of |in_fence_fd|.
+  // If |out_fence_fd| is not null, it gets a fd that signals when |fb_id|
+  // reaches the screen, or -1 without explicit fencing.
+  // The flip event goes to the client of |output|.
+  bool PageFlip(size_t output,
+                uint32_t fb_id,
+                int in_fence_fd,
+                int* out_fence_fd);
+
+  // False if the primary plane of |output| can't scan out the DRM fourcc
+  // |format|. Without atomic modesetting the planes aren't known, so it's
+  // true, and adding the framebuffer is the only test.
+  bool IsFormatSupported(size_t output, uint32_t format) const;
+
+  // True if framebuffers can be added with explicit format modifiers, which
+  // needs atomic modesetting and DRM_CAP_ADDFB2_MODIFIERS.
+  bool IsModifierSupported() const;
+  // The modifiers that the primary plane of |output| can scan out the DRM
+  // fourcc |format| with, in no particular order. Empty if the driver
+  // doesn't list them; then only buffers with implicit modifiers are safe.
+  std::vector<uint64_t> GetModifiers(size_t output, uint32_t format) const;
+
+  // Reserves an overlay plane of |output| that can scan out the DRM fourcc
+  // |format| with |modifier|, or with any if it's DRM_FORMAT_MOD_INVALID.
+  // Returns the plane, or -1 if every such plane is taken or there is no
+  // atomic modesetting.
+  int AllocateOverlayPlane(size_t output, uint32_t format, uint64_t modifier);
+  void FreeOverlayPlane(int plane);
+  // True if the display can show |overlay| on |output| as it is now, which is
+  // checked with a test-only atomic commit.
+  bool TestOverlay(size_t output, const Overlay& overlay);
+
+  // Runs the event loop until Stop(), or any input on stdin unless
+  // SetWatchStdin(false) turned that off, e.g. for runs without a terminal.
   bool Run();
+  void SetWatchStdin(bool watch);
+  // Makes Run() return once the pending page flips land. Call it on the thread
+  // running the loop, e.g. from a callback registered to GetEventLoop().
+  void Stop();
+
+  // Clients can add their own fds, timers and signals to the loop that
+  // handles page flips.
+  EventLoop* GetEventLoop();
+
+  // Thread-safe. Makes Run() ask the client for a queued buffer again, e.g.
+  // when another thread has finished rendering one.
+  void Wakeup();
 
  private:
   DRMModesetter();
 
-  bool Initialize(const std::string& card);
+  bool Initialize(const std::string& card, bool atomic);
+  bool InitializeHeadless(const HeadlessConfig& config);
 
   class Impl;
   std::unique_ptr<Impl> impl_;
@@ -27,20 +27,43 @@
 #include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <drm_fourcc.h>
+#include <fcntl.h>
 #include <gbm.h>
+#include <linux/dma-buf.h>
+#include <linux/kcmp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
 #include <unistd.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <cinttypes>
 #include <cstring>
+#include <ctime>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "drm_modesetter.h"
-
-// double buffering
-#define NUM_BUFFERS 2
+#include "event_loop.h"
+#include "frame_pacer.h"
+#include "frame_stats.h"
+#include "pixel_kernels.h"
+#include "spsc_queue.h"
+#include "swapchain.h"
+#include "write_only_guard.h"
 
 namespace ged {
 namespace {
@@ -55,8 +78,31 @@ struct EGLGlue {
   PFNEGLDESTROYIMAGEKHRPROC DestroyImageKHR;
   PFNGLEGLIMAGETARGETTEXTURE2DOESPROC EGLImageTargetTexture2DOES;
   PFNEGLCREATESYNCKHRPROC CreateSyncKHR;
+  PFNEGLDESTROYSYNCKHRPROC DestroySyncKHR;
   PFNEGLCLIENTWAITSYNCKHRPROC ClientWaitSyncKHR;
+  PFNEGLWAITSYNCKHRPROC WaitSyncKHR;
+  PFNEGLDUPNATIVEFENCEFDANDROIDPROC DupNativeFenceFDANDROID;
+  PFNGLGENQUERIESEXTPROC GenQueriesEXT;
+  PFNGLDELETEQUERIESEXTPROC DeleteQueriesEXT;
+  PFNGLBEGINQUERYEXTPROC BeginQueryEXT;
+  PFNGLENDQUERYEXTPROC EndQueryEXT;
+  PFNGLGETQUERYOBJECTUIVEXTPROC GetQueryObjectuivEXT;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC GetQueryObjectui64vEXT;
+  PFNEGLQUERYDMABUFFORMATSEXTPROC QueryDmaBufFormatsEXT;
+  PFNEGLQUERYDMABUFMODIFIERSEXTPROC QueryDmaBufModifiersEXT;
   bool egl_sync_supported;
+  // GL_EXT_texture_format_BGRA8888
+  bool bgra_texture_supported;
+  // EGL_ANDROID_native_fence_sync and EGL_KHR_wait_sync
+  bool native_fence_supported;
+  // GL_EXT_disjoint_timer_query
+  bool timer_query_supported;
+  // EGL_EXT_image_dma_buf_import_modifiers
+  bool modifiers_supported;
+  // GL_OES_EGL_image_external
+  bool external_texture_supported;
+  // EGL_EXT_image_dma_buf_import
+  bool dma_buf_import_supported;
 };
 
 const char* EglGetError() {
@@ -96,175 +142,1506 @@ const char* EglGetError() {
   }
 }
 
-class StreamTextureImpl : public StreamTexture {
+struct FormatInfo {
+  uint32_t format;
+  int bytes_per_pixel;
+  // to upload it with glTexImage2D, or 0 if GLES2 has no such format
+  GLenum gl_format;
+  GLenum gl_type;
+};
+
+// The formats we know how to allocate and sample. GBM_FORMAT_ARGB8888 is
+// BGRA in memory.
+const FormatInfo* GetFormatInfo(uint32_t format) {
+  static const FormatInfo kFormats[] = {
+      {GBM_FORMAT_XRGB8888, 4, GL_BGRA_EXT, GL_UNSIGNED_BYTE},
+      {GBM_FORMAT_ARGB8888, 4, GL_BGRA_EXT, GL_UNSIGNED_BYTE},
+      {GBM_FORMAT_RGB565, 2, GL_RGB, GL_UNSIGNED_SHORT_5_6_5},
+      {GBM_FORMAT_XRGB2101010, 4, 0, 0},
+      {GBM_FORMAT_ARGB2101010, 4, 0, 0},
+  };
+  for (const FormatInfo& info : kFormats) {
+    if (info.format == format)
+      return &info;
+  }
+  return nullptr;
+}
+
+// One plane of a multi-planar format. A plane of 2 bytes per pixel, e.g.
+// DRM_FORMAT_GR88, is interleaved U and V. Subsampled planes have 1 pixel for
+// every |subsampling| x |subsampling| pixels of the image.
+struct PlaneFormat {
+  uint32_t format;
+  int bytes_per_pixel;
+  int subsampling;
+};
+
+// The planes to allocate |format| in, or empty if we don't know it. Only the
+// 4:2:0 YUV formats have more than 1.
+std::vector<PlaneFormat> GetPlaneFormats(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_NV12:
+      return {{DRM_FORMAT_R8, 1, 1}, {DRM_FORMAT_GR88, 2, 2}};
+    case DRM_FORMAT_P010:
+      // 10 bits in the high bits of 16.
+      return {{DRM_FORMAT_R16, 2, 1}, {DRM_FORMAT_GR1616, 4, 2}};
+    case DRM_FORMAT_YUV420:
+      return {{DRM_FORMAT_R8, 1, 1},
+              {DRM_FORMAT_R8, 1, 2},
+              {DRM_FORMAT_R8, 1, 2}};
+  }
+  const FormatInfo* info = GetFormatInfo(format);
+  if (!info)
+    return {};
+  return {{format, info->bytes_per_pixel, 1}};
+}
+
+// Where the planes of an image are. They can share a buffer, like the
+// compression metadata of CCS or AFBC, or each have their own.
+struct BufferLayout {
+  struct Plane {
+    int fd;
+    // the GEM handle on the DRM device, or 0
+    uint32_t handle;
+    uint32_t offset;
+    uint32_t stride;
+  };
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t format = 0;
+  // DRM_FORMAT_MOD_INVALID if the driver picked the layout implicitly
+  uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+  std::vector<Plane> planes;
+};
+
+// Adds the planes of |bo|, whose dma_buf is |fd|. Only with an explicit
+// modifier can it have more planes than its format.
+void AddPlanes(struct gbm_bo* bo,
+               int fd,
+               bool explicit_modifier,
+               BufferLayout* layout) {
+  int count = explicit_modifier ? gbm_bo_get_plane_count(bo) : 1;
+  if (count <= 0 || count > 4)
+    count = 1;
+  for (int i = 0; i < count; ++i) {
+    layout->planes.push_back({fd, gbm_bo_get_handle_for_plane(bo, i).u32,
+                              gbm_bo_get_offset(bo, i),
+                              gbm_bo_get_stride_for_plane(bo, i)});
+  }
+}
+
+BufferLayout GetLayout(struct gbm_bo* bo,
+                       int fd,
+                       uint32_t format,
+                       bool explicit_modifier) {
+  BufferLayout layout;
+  layout.width = gbm_bo_get_width(bo);
+  layout.height = gbm_bo_get_height(bo);
+  layout.format = format;
+  if (explicit_modifier)
+    layout.modifier = gbm_bo_get_modifier(bo);
+  AddPlanes(bo, fd, explicit_modifier, &layout);
+  return layout;
+}
+
+EGLImageKHR CreateImage(const EGLGlue& egl, const BufferLayout& layout) {
+  static const EGLint kPlaneAttribs[4][5] = {
+      {EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE3_FD_EXT, EGL_DMA_BUF_PLANE3_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE3_PITCH_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT}};
+
+  if (layout.planes.empty() || layout.planes.size() > 4)
+    return EGL_NO_IMAGE_KHR;
+  std::vector<EGLint> attribs = {EGL_WIDTH,
+                                 static_cast<EGLint>(layout.width),
+                                 EGL_HEIGHT,
+                                 static_cast<EGLint>(layout.height),
+                                 EGL_LINUX_DRM_FOURCC_EXT,
+                                 static_cast<EGLint>(layout.format)};
+  uint64_t modifier = layout.modifier;
+  for (size_t i = 0; i < layout.planes.size(); ++i) {
+    const EGLint* names = kPlaneAttribs[i];
+    const BufferLayout::Plane& plane = layout.planes[i];
+    attribs.insert(attribs.end(),
+                   {names[0], plane.fd, names[1],
+                    static_cast<EGLint>(plane.offset), names[2],
+                    static_cast<EGLint>(plane.stride)});
+    if (modifier != DRM_FORMAT_MOD_INVALID) {
+      attribs.insert(attribs.end(),
+                     {names[3], static_cast<EGLint>(modifier & 0xffffffff),
+                      names[4], static_cast<EGLint>(modifier >> 32)});
+    }
+  }
+  attribs.push_back(EGL_NONE);
+
+  return egl.CreateImageKHR(egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
+                            nullptr /* no client buffer */, attribs.data());
+}
+
+// Returns the framebuffer ID, or 0.
+uint32_t AddFramebuffer(int drm_fd, const BufferLayout& layout) {
+  uint32_t handles[4] = {};
+  uint32_t strides[4] = {};
+  uint32_t offsets[4] = {};
+  uint64_t modifiers[4] = {};
+  if (layout.planes.empty() || layout.planes.size() > 4)
+    return 0;
+  for (size_t i = 0; i < layout.planes.size(); ++i) {
+    handles[i] = layout.planes[i].handle;
+    strides[i] = layout.planes[i].stride;
+    offsets[i] = layout.planes[i].offset;
+    modifiers[i] = layout.modifier;
+  }
+
+  uint32_t fb_id = 0;
+  int ret;
+  if (layout.modifier != DRM_FORMAT_MOD_INVALID) {
+    ret = drmModeAddFB2WithModifiers(drm_fd, layout.width, layout.height,
+                                     layout.format, handles, strides, offsets,
+                                     modifiers, &fb_id, DRM_MODE_FB_MODIFIERS);
+  } else {
+    ret = drmModeAddFB2(drm_fd, layout.width, layout.height, layout.format,
+                        handles, strides, offsets, &fb_id, 0);
+  }
+  return ret ? 0 : fb_id;
+}
+
+// Like AddFramebuffer(), for a dma_buf from another device. The GEM handles
+// are needed only until the framebuffer holds the buffer.
+uint32_t AddImportedFramebuffer(int drm_fd, BufferLayout layout) {
+  std::vector<uint32_t> handles;
+  bool imported = true;
+  for (BufferLayout::Plane& plane : layout.planes) {
+    if (drmPrimeFDToHandle(drm_fd, plane.fd, &plane.handle)) {
+      fprintf(stderr, "cannot import dma_buf to the DRM device: %m\n");
+      imported = false;
+      break;
+    }
+    handles.push_back(plane.handle);
+  }
+  uint32_t fb_id = imported ? AddFramebuffer(drm_fd, layout) : 0;
+  // Planes in the same dma_buf share a handle.
+  std::sort(handles.begin(), handles.end());
+  handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+  for (uint32_t handle : handles)
+    drmCloseBufferHandle(drm_fd, handle);
+  return fb_id;
+}
+
+static_assert(EGLDRMGlue::DmaBuf::kModifierInvalid == DRM_FORMAT_MOD_INVALID,
+              "kModifierInvalid must be DRM_FORMAT_MOD_INVALID");
+
+// DMA_BUF_MAGIC of <linux/magic.h>, the filesystem of dma_bufs since Linux
+// 5.3. Older headers don't have it.
+const long kDmaBufMagic = 0x444d4142;
+
+bool IsEmpty(const StreamTexture::Rect& rect) {
+  return rect.width <= 0 || rect.height <= 0;
+}
+
+// The smallest rect covering both.
+StreamTexture::Rect UnionRects(const StreamTexture::Rect& a,
+                               const StreamTexture::Rect& b) {
+  if (IsEmpty(a))
+    return b;
+  if (IsEmpty(b))
+    return a;
+  int left = std::min(a.x, b.x);
+  int top = std::min(a.y, b.y);
+  int right = std::max(a.x + a.width, b.x + b.width);
+  int bottom = std::max(a.y + a.height, b.y + b.height);
+  return {left, top, right - left, bottom - top};
+}
+
+StreamTexture::Rect IntersectRects(const StreamTexture::Rect& a,
+                                   const StreamTexture::Rect& b) {
+  int left = std::max(a.x, b.x);
+  int top = std::max(a.y, b.y);
+  int right = std::min(a.x + a.width, b.x + b.width);
+  int bottom = std::min(a.y + a.height, b.y + b.height);
+  if (right <= left || bottom <= top)
+    return {0, 0, 0, 0};
+  return {left, top, right - left, bottom - top};
+}
+
+bool ContainsRect(const StreamTexture::Rect& outer,
+                  const StreamTexture::Rect& inner) {
+  return IsEmpty(inner) ||
+         (inner.x >= outer.x && inner.y >= outer.y &&
+          inner.x + inner.width <= outer.x + outer.width &&
+          inner.y + inner.height <= outer.y + outer.height);
+}
+
+/*
+ * A stream texture that an overlay plane can scan out. The display reads the
+ * buffer until the next flip replaces it, so AcquireScanout() keeps it from
+ * being written until ReleaseScanout(). Both are thread-safe.
+ */
+class ScanoutStreamTexture : public StreamTexture {
  public:
-  static std::unique_ptr<StreamTexture> Create(struct gbm_device* gbm,
-                                               const EGLGlue& egl,
-                                               size_t width,
-                                               size_t height) {
-    std::unique_ptr<StreamTextureImpl> texture(
-        new StreamTextureImpl(egl, width, height));
-    if (texture->Initialize(gbm))
+  // Returns the framebuffer holding the newest pixels, or 0 if the texture
+  // can't be scanned out.
+  virtual uint32_t AcquireScanout() = 0;
+  // Returns false if |fb_id| isn't of this texture.
+  virtual bool ReleaseScanout(uint32_t fb_id) = 0;
+  virtual bool IsScanningOut() const = 0;
+  // DRM_FORMAT_MOD_INVALID if the driver picked the layout implicitly.
+  virtual uint64_t GetModifier() const = 0;
+  // Shows |dma_buf| from now on. Only textures from ImportStreamTexture()
+  // can.
+  virtual bool Import(const EGLDRMGlue::DmaBuf& dma_buf) { return false; }
+};
+
+class StreamTextureImpl : public ScanoutStreamTexture {
+ public:
+  // Without a |drm_fd|, the texture can't be scanned out. With
+  // |explicit_modifier|, the buffer is allocated and imported as
+  // DRM_FORMAT_MOD_LINEAR, which planes listing modifiers need.
+  static std::unique_ptr<ScanoutStreamTexture> Create(struct gbm_device* gbm,
+                                                      const EGLGlue& egl,
+                                                      int drm_fd,
+                                                      bool explicit_modifier,
+                                                      uint32_t format,
+                                                      size_t width,
+                                                      size_t height,
+                                                      bool detect_reads) {
+    std::unique_ptr<StreamTextureImpl> texture(new StreamTextureImpl(
+        egl, drm_fd, explicit_modifier, format, width, height));
+    if (texture->Initialize(gbm, detect_reads))
       return std::move(texture);
     return nullptr;
   }
 
   ~StreamTextureImpl() override {
+    assert(!sync_flags_);
+    if (fb_id_)
+      drmModeRmFB(drm_fd_, fb_id_);
     glDeleteTextures(1, &gl_tex_);
-    egl_->DestroyImageKHR(egl_->display, image_);
-    close(fd_);
-    gbm_bo_destroy(bo_);
+    if (image_)
+      egl_->DestroyImageKHR(egl_->display, image_);
+    FreePlanes();
   }
 
-  void* Map() final {
-    assert(addr_ == nullptr);
-    size_t size = dimension_.stride * dimension_.height;
-    addr_ = mmap(nullptr, size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd_, 0);
-    if (addr_ == MAP_FAILED)
-      return nullptr;
-    return addr_;
+  // DMA_BUF_IOCTL_SYNC has no range, so the whole buffer is synced anyway,
+  // and the pixels outside of |rect| stay where they are.
+  void* Map(Access access, const Rect& rect) final {
+    assert(!sync_flags_);
+    switch (access) {
+      case Access::READ:
+        sync_flags_ = DMA_BUF_SYNC_READ;
+        break;
+      case Access::WRITE:
+        sync_flags_ = DMA_BUF_SYNC_WRITE;
+        break;
+      case Access::READ_WRITE:
+        sync_flags_ = DMA_BUF_SYNC_RW;
+        break;
+    }
+    for (Plane& plane : planes_) {
+      SyncDmaBuf(plane.fd, DMA_BUF_SYNC_START | sync_flags_);
+      if (plane.read_guard && access == Access::WRITE)
+        plane.read_guard->Protect();
+    }
+    return planes_[0].addr;
   }
 
+  void MarkDirty(const Rect& rect) final {}
+
   void Unmap() final {
-    assert(addr_ != nullptr);
-    size_t size = dimension_.stride * dimension_.height;
-    munmap(addr_, size);
-    addr_ = nullptr;
+    assert(sync_flags_);
+    // The streaming stores of this thread must land before the GPU reads.
+    pixel::StreamFence();
+    for (size_t i = 0; i < planes_.size(); ++i) {
+      Plane& plane = planes_[i];
+      if (plane.read_guard && sync_flags_ == DMA_BUF_SYNC_WRITE) {
+        size_t first_read_offset = 0;
+        size_t reads = plane.read_guard->Unprotect(&first_read_offset);
+        if (reads) {
+          fprintf(stderr,
+                  "%zu pages of a write-only mapping were read, first at "
+                  "offset %zu of the plane %zu.\n",
+                  reads, first_read_offset, i);
+        }
+      }
+      SyncDmaBuf(plane.fd, DMA_BUF_SYNC_END | sync_flags_);
+    }
+    sync_flags_ = 0;
   }
 
   GLuint GetTextureID() const final { return gl_tex_; }
-  Dimension GetDimension() const final { return dimension_; }
+  Dimension GetDimension() const final { return planes_[0].dimension; }
 
- private:
-  StreamTextureImpl(const EGLGlue& egl, size_t width, size_t height)
-      : egl_(&egl), dimension_() {
-    dimension_.width = width;
-    dimension_.height = height;
+  size_t GetPlaneCount() const final { return planes_.size(); }
+
+  void* GetPlaneData(size_t plane) final {
+    assert(sync_flags_);
+    return planes_[plane].addr;
   }
 
-  bool Initialize(struct gbm_device* gbm) {
-    bo_ = gbm_bo_create(gbm, dimension_.width, dimension_.height,
-                        GBM_FORMAT_ARGB8888, GBM_BO_USE_LINEAR);
-    if (!bo_) {
-      fprintf(stderr, "failed to create a gbm buffer.\n");
-      return false;
+  Dimension GetPlaneDimension(size_t plane) const final {
+    return planes_[plane].dimension;
+  }
+
+  bool IsExternal() const final { return target_ == GL_TEXTURE_EXTERNAL_OES; }
+
+  // The framebuffer is made on the first use; most textures never need one.
+  uint32_t AcquireScanout() final {
+    if (!fb_id_ && !add_fb_failed_) {
+      if (drm_fd_ >= 0)
+        fb_id_ = AddFramebuffer(drm_fd_, GetLayout());
+      add_fb_failed_ = !fb_id_;
     }
+    if (fb_id_)
+      ++scanout_count_;
+    return fb_id_;
+  }
 
-    fd_ = gbm_bo_get_fd(bo_);
-    if (fd_ < 0) {
-      fprintf(stderr, "failed to get fb for bo: %d", fd_);
+  bool ReleaseScanout(uint32_t fb_id) final {
+    if (!fb_id || fb_id != fb_id_)
       return false;
+    int count = scanout_count_--;
+    assert(count > 0);
+    (void)count;
+    return true;
+  }
+
+  bool IsScanningOut() const final { return scanout_count_ > 0; }
+
+  uint64_t GetModifier() const final {
+    return explicit_modifier_ ? DRM_FORMAT_MOD_LINEAR : DRM_FORMAT_MOD_INVALID;
+  }
+
+  uint32_t GetFormat() const final { return format_; }
+
+ private:
+  struct Plane {
+    struct gbm_bo* bo = nullptr;
+    int fd = -1;
+    Dimension dimension;
+    // mapped for the lifetime of the texture
+    void* addr = nullptr;
+    size_t size = 0;
+    // counts reads while mapped for Access::WRITE, if asked
+    std::unique_ptr<WriteOnlyGuard> read_guard;
+  };
+
+  StreamTextureImpl(const EGLGlue& egl,
+                    int drm_fd,
+                    bool explicit_modifier,
+                    uint32_t format,
+                    size_t width,
+                    size_t height)
+      : egl_(&egl),
+        drm_fd_(drm_fd),
+        explicit_modifier_(explicit_modifier),
+        format_(format),
+        width_(width),
+        height_(height) {}
+
+  bool Initialize(struct gbm_device* gbm, bool detect_reads) {
+    std::vector<PlaneFormat> plane_formats = GetPlaneFormats(format_);
+    if (plane_formats.empty()) {
+      fprintf(stderr, "unknown stream texture format.\n");
+      return false;
+    }
+    // The CPU writes the pixels in order, so the layout can only be linear.
+    // Tiled layouts would need a detiling copy on every Map().
+    if (!explicit_modifier_ || !AllocatePlanes(gbm, plane_formats, true)) {
+      FreePlanes();
+      explicit_modifier_ = false;
+      if (!AllocatePlanes(gbm, plane_formats, false)) {
+        fprintf(stderr, "failed to create a gbm buffer.\n");
+        return false;
+      }
     }
 
-    dimension_.stride = gbm_bo_get_stride(bo_);
-    EGLint offset = 0;
-    const EGLint khr_image_attrs[] = {EGL_DMA_BUF_PLANE0_FD_EXT,
-                                      fd_,
-                                      EGL_WIDTH,
-                                      dimension_.width,
-                                      EGL_HEIGHT,
-                                      dimension_.height,
-                                      EGL_LINUX_DRM_FOURCC_EXT,
-                                      GBM_FORMAT_ARGB8888,
-                                      EGL_DMA_BUF_PLANE0_PITCH_EXT,
-                                      dimension_.stride,
-                                      EGL_DMA_BUF_PLANE0_OFFSET_EXT,
-                                      offset,
-                                      EGL_NONE};
+    for (Plane& plane : planes_) {
+      // Map once, instead of paying for mmap(), munmap() and the page faults
+      // on every frame.
+      plane.size = plane.dimension.stride * plane.dimension.height;
+      plane.addr = mmap(nullptr, plane.size, (PROT_READ | PROT_WRITE),
+                        MAP_SHARED, plane.fd, 0);
+      if (plane.addr == MAP_FAILED) {
+        plane.addr = nullptr;
+        fprintf(stderr, "failed to mmap dma_buf: %m\n");
+        return false;
+      }
+      // Debugging only; the texture works without it.
+      if (detect_reads)
+        plane.read_guard = WriteOnlyGuard::Create(plane.addr, plane.size);
+    }
 
-    image_ = egl_->CreateImageKHR(
-        egl_->display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
-        nullptr /* no client buffer */, khr_image_attrs);
+    image_ = CreateImage(*egl_, GetLayout());
     if (image_ == EGL_NO_IMAGE_KHR) {
       fprintf(stderr, "failed to make image from buffer object: %s\n",
               EglGetError());
       return false;
     }
 
+    // The sampler converts YUV to RGB, which only external textures do.
+    target_ = planes_.size() > 1 ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D;
     glGenTextures(1, &gl_tex_);
+    glBindTexture(target_, gl_tex_);
+    egl_->EGLImageTargetTexture2DOES(target_, image_);
+    glTexParameteri(target_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(target_, 0);
+    return true;
+  }
+
+  // Every plane gets its own buffer, which any GBM can allocate, and the
+  // image puts them together.
+  bool AllocatePlanes(struct gbm_device* gbm,
+                      const std::vector<PlaneFormat>& plane_formats,
+                      bool explicit_modifier) {
+    for (const PlaneFormat& plane_format : plane_formats) {
+      int subsampling = plane_format.subsampling;
+      uint32_t width = (width_ + subsampling - 1) / subsampling;
+      uint32_t height = (height_ + subsampling - 1) / subsampling;
+      struct gbm_bo* bo = nullptr;
+      if (explicit_modifier) {
+        static const uint64_t kLinear = DRM_FORMAT_MOD_LINEAR;
+        bo = gbm_bo_create_with_modifiers(gbm, width, height,
+                                          plane_format.format, &kLinear, 1);
+      } else {
+        // Scanout memory lets an overlay plane show the texture, but not
+        // every driver has it for every size.
+        if (drm_fd_ >= 0) {
+          bo = gbm_bo_create(gbm, width, height, plane_format.format,
+                             GBM_BO_USE_LINEAR | GBM_BO_USE_SCANOUT);
+        }
+        if (!bo) {
+          bo = gbm_bo_create(gbm, width, height, plane_format.format,
+                             GBM_BO_USE_LINEAR);
+        }
+      }
+      if (!bo)
+        return false;
+
+      planes_.emplace_back();
+      Plane& plane = planes_.back();
+      plane.bo = bo;
+      plane.fd = gbm_bo_get_fd(bo);
+      if (plane.fd < 0) {
+        fprintf(stderr, "failed to get fb for bo: %d", plane.fd);
+        return false;
+      }
+      plane.dimension.width = width;
+      plane.dimension.height = height;
+      plane.dimension.stride = gbm_bo_get_stride(bo);
+    }
+    return true;
+  }
+
+  void FreePlanes() {
+    for (Plane& plane : planes_) {
+      plane.read_guard.reset();
+      if (plane.addr)
+        munmap(plane.addr, plane.size);
+      if (plane.fd >= 0)
+        close(plane.fd);
+      if (plane.bo)
+        gbm_bo_destroy(plane.bo);
+    }
+    planes_.clear();
+  }
+
+  BufferLayout GetLayout() const {
+    BufferLayout layout;
+    layout.width = width_;
+    layout.height = height_;
+    layout.format = format_;
+    if (explicit_modifier_)
+      layout.modifier = DRM_FORMAT_MOD_LINEAR;
+    for (const Plane& plane : planes_)
+      AddPlanes(plane.bo, plane.fd, false, &layout);
+    return layout;
+  }
+
+  // Kernels before v4.6 don't know DMA_BUF_IOCTL_SYNC. Then the mapping is
+  // coherent only on some hardware, but there is nothing better to do.
+  void SyncDmaBuf(int fd, uint64_t flags) {
+    dma_buf_sync sync = {flags};
+    int ret;
+    do {
+      ret = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+    if (ret && !sync_failed_) {
+      fprintf(stderr, "DMA_BUF_IOCTL_SYNC failed: %m\n");
+      sync_failed_ = true;
+    }
+  }
+
+  const EGLGlue* const egl_;
+  const int drm_fd_;
+  bool explicit_modifier_;
+  const uint32_t format_;
+  const uint32_t width_;
+  const uint32_t height_;
+  // 1 for RGB, 2 or 3 for YUV
+  std::vector<Plane> planes_;
+  EGLImageKHR image_ = nullptr;
+  GLuint gl_tex_ = 0;
+  GLenum target_ = GL_TEXTURE_2D;
+  uint32_t fb_id_ = 0;
+  bool add_fb_failed_ = false;
+  // how many flips show the buffer now or are about to
+  std::atomic<int> scanout_count_{0};
+  // DMA_BUF_SYNC_READ and/or DMA_BUF_SYNC_WRITE while mapped, or 0.
+  uint64_t sync_flags_ = 0;
+  bool sync_failed_ = false;
+};
+
+/*
+ * Without a GBM device, e.g. headless on llvmpipe, there is no dma_buf to map.
+ * Map() returns a system memory copy instead, and Unmap() uploads it.
+ */
+class HostStreamTextureImpl : public ScanoutStreamTexture {
+ public:
+  static std::unique_ptr<ScanoutStreamTexture> Create(const EGLGlue& egl,
+                                                      uint32_t format,
+                                                      size_t width,
+                                                      size_t height) {
+    const FormatInfo* info = GetFormatInfo(format);
+    if (!info || !info->gl_format) {
+      fprintf(stderr, "GLES2 can't upload the format.\n");
+      return nullptr;
+    }
+    std::unique_ptr<HostStreamTextureImpl> texture(
+        new HostStreamTextureImpl(egl, *info, width, height));
+    return std::move(texture);
+  }
+
+  ~HostStreamTextureImpl() override { glDeleteTextures(1, &gl_tex_); }
+
+  void* Map(Access access, const Rect& rect) final {
+    access_ = access;
+    dirty_ = rect;
+    return pixels_.data();
+  }
+
+  void MarkDirty(const Rect& rect) final { dirty_ = UnionRects(dirty_, rect); }
+
+  void Unmap() final {
+    if (access_ == Access::READ)
+      return;
+    Rect rows = IntersectRects(
+        dirty_, {0, 0, dimension_.width, dimension_.height});
+    if (IsEmpty(rows))
+      return;
+    // Rows of 2 byte pixels aren't always 4 byte aligned.
+    GLint alignment = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glBindTexture(GL_TEXTURE_2D, gl_tex_);
-    egl_->EGLImageTargetTexture2DOES(GL_TEXTURE_2D, image_);
+    // GLES2 has no GL_UNPACK_ROW_LENGTH, so only whole rows can be uploaded.
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rows.y, dimension_.width,
+                    rows.height, gl_format_, info_.gl_type,
+                    pixels_.data() + rows.y * dimension_.stride);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+  }
+
+  GLuint GetTextureID() const final { return gl_tex_; }
+  Dimension GetDimension() const final { return dimension_; }
+
+  uint32_t AcquireScanout() final { return 0; }
+  bool ReleaseScanout(uint32_t fb_id) final { return false; }
+  bool IsScanningOut() const final { return false; }
+  uint64_t GetModifier() const final { return DRM_FORMAT_MOD_INVALID; }
+  uint32_t GetFormat() const final { return info_.format; }
+
+  size_t GetPlaneCount() const final { return 1; }
+  void* GetPlaneData(size_t plane) final { return pixels_.data(); }
+  Dimension GetPlaneDimension(size_t plane) const final { return dimension_; }
+  bool IsExternal() const final { return false; }
+
+ private:
+  HostStreamTextureImpl(const EGLGlue& egl,
+                        const FormatInfo& info,
+                        size_t width,
+                        size_t height)
+      : dimension_(),
+        info_(info),
+        // Without the BGRA extension, red and blue are swapped, which
+        // doesn't matter for benchmarks.
+        gl_format_(info.gl_format == GL_BGRA_EXT && !egl.bgra_texture_supported
+                       ? GL_RGBA
+                       : info.gl_format) {
+    dimension_.width = width;
+    dimension_.height = height;
+    dimension_.stride = width * info.bytes_per_pixel;
+    pixels_.resize(dimension_.stride * height);
+
+    glGenTextures(1, &gl_tex_);
+    glBindTexture(GL_TEXTURE_2D, gl_tex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, gl_format_, width, height, 0, gl_format_,
+                 info.gl_type, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
-    return true;
   }
 
-  const EGLGlue* const egl_;
-  struct gbm_bo* bo_ = nullptr;
-  int fd_ = -1;
-  EGLImageKHR image_ = nullptr;
   GLuint gl_tex_ = 0;
   Dimension dimension_;
-  void* addr_ = nullptr;
+  const FormatInfo info_;
+  const GLenum gl_format_;
+  std::vector<uint8_t> pixels_;
+  Access access_ = Access::READ_WRITE;
+  // the rows to upload on Unmap()
+  Rect dirty_ = {0, 0, 0, 0};
 };
 
-}  // namespace
+/*
+ * StreamTextureRing spreads a stream texture over N textures, so that the CPU
+ * writes one while the GPU still samples the others. GetTextureID() is the
+ * texture unmapped last. A texture that stops being the newest gets a fence,
+ * and is written again only after the fence signals, i.e. after the GPU has
+ * finished the draws that were issued while it was the newest.
+ * On an overlay plane, the slots on the screen are skipped as well.
+ * A slot keeps the rect that the others got since it was written last, and
+ * catches up by copying it from the newest one before it's mapped again.
+ */
+class StreamTextureRing : public ScanoutStreamTexture {
+ public:
+  static const size_t kMaxSlots = 8;
+
+  static std::unique_ptr<ScanoutStreamTexture> Create(
+      const EGLGlue& egl,
+      std::vector<std::unique_ptr<ScanoutStreamTexture>> slots) {
+    std::unique_ptr<StreamTextureRing> texture(
+        new StreamTextureRing(egl, std::move(slots)));
+    return std::move(texture);
+  }
+
+  ~StreamTextureRing() override {
+    assert(mapped_ == -1);
+    for (auto& slot : slots_) {
+      if (slot.fence != EGL_NO_SYNC_KHR)
+        egl_->DestroySyncKHR(egl_->display, slot.fence);
+    }
+  }
+
+  void* Map(Access access, const Rect& rect) final {
+    assert(mapped_ == -1);
+    mapped_ = AcquireSlot();
+    Slot& slot = slots_[mapped_];
+    Dimension dimension = slot.texture->GetDimension();
+    dirty_ = access == Access::READ
+                 ? Rect{0, 0, 0, 0}
+                 : IntersectRects(rect,
+                                  {0, 0, dimension.width, dimension.height});
+    // Unless the caller writes all of it anyway, the stale part is copied
+    // into the slot, even if it's only read.
+    bool catch_up =
+        !IsEmpty(slot.stale) &&
+        (access != Access::WRITE || !ContainsRect(dirty_, slot.stale));
+    if (!catch_up)
+      slot.stale = {0, 0, 0, 0};
+    if (catch_up && access == Access::READ)
+      access = Access::READ_WRITE;
+    void* pixels = slot.texture->Map(access, dirty_);
+    if (pixels && catch_up)
+      CatchUp(slot);
+    return pixels;
+  }
 
-class EGLDRMGlue::Impl : public DRMModesetter::Client {
+  void MarkDirty(const Rect& rect) final {
+    assert(mapped_ != -1);
+    dirty_ = UnionRects(dirty_, rect);
+    slots_[mapped_].texture->MarkDirty(rect);
+  }
+
+  void Unmap() final {
+    assert(mapped_ != -1);
+    slots_[mapped_].texture->Unmap();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (int(i) != mapped_)
+        slots_[i].stale = UnionRects(slots_[i].stale, dirty_);
+    }
+    RetireSlot(newest_);
+    newest_ = mapped_;
+    mapped_ = -1;
+  }
+
+  GLuint GetTextureID() const final {
+    return slots_[newest_].texture->GetTextureID();
+  }
+
+  Dimension GetDimension() const final {
+    int slot = mapped_ != -1 ? mapped_ : newest_;
+    return slots_[slot].texture->GetDimension();
+  }
+
+  uint32_t AcquireScanout() final {
+    return slots_[newest_].texture->AcquireScanout();
+  }
+
+  bool ReleaseScanout(uint32_t fb_id) final {
+    for (auto& slot : slots_) {
+      if (slot.texture->ReleaseScanout(fb_id))
+        return true;
+    }
+    return false;
+  }
+
+  bool IsScanningOut() const final {
+    for (auto& slot : slots_) {
+      if (slot.texture->IsScanningOut())
+        return true;
+    }
+    return false;
+  }
+
+  uint64_t GetModifier() const final {
+    return slots_[newest_].texture->GetModifier();
+  }
+
+  uint32_t GetFormat() const final {
+    return slots_[newest_].texture->GetFormat();
+  }
+
+  size_t GetPlaneCount() const final {
+    return slots_[newest_].texture->GetPlaneCount();
+  }
+
+  void* GetPlaneData(size_t plane) final {
+    assert(mapped_ != -1);
+    return slots_[mapped_].texture->GetPlaneData(plane);
+  }
+
+  Dimension GetPlaneDimension(size_t plane) const final {
+    int slot = mapped_ != -1 ? mapped_ : newest_;
+    return slots_[slot].texture->GetPlaneDimension(plane);
+  }
+
+  bool IsExternal() const final {
+    return slots_[newest_].texture->IsExternal();
+  }
+
+ private:
+  struct Slot {
+    std::unique_ptr<ScanoutStreamTexture> texture;
+    // signals when the GPU doesn't sample |texture| any more
+    EGLSyncKHR fence = EGL_NO_SYNC_KHR;
+    // written into the other slots since this one was written last
+    Rect stale = {0, 0, 0, 0};
+  };
+
+  StreamTextureRing(
+      const EGLGlue& egl,
+      std::vector<std::unique_ptr<ScanoutStreamTexture>> textures)
+      : egl_(&egl), slots_(textures.size()) {
+    for (size_t i = 0; i < textures.size(); ++i)
+      slots_[i].texture = std::move(textures[i]);
+  }
+
+  // Returns the first idle slot after the last written one. If every slot is
+  // busy, waits for the oldest one that isn't on the screen. Only when every
+  // slot is on the screen, the write may tear.
+  int AcquireSlot() {
+    int count = slots_.size();
+    for (int i = 1; i < count; ++i) {
+      int slot = (newest_ + i) % count;
+      if (!slots_[slot].texture->IsScanningOut() && IsIdle(slots_[slot]))
+        return slot;
+    }
+    int oldest = (newest_ + 1) % count;
+    for (int i = 1; i < count; ++i) {
+      int slot = (newest_ + i) % count;
+      if (!slots_[slot].texture->IsScanningOut()) {
+        oldest = slot;
+        break;
+      }
+    }
+    WaitForIdle(slots_[oldest]);
+    return oldest;
+  }
+
+  // Copies |slot.stale| of every plane from the newest slot, which the CPU
+  // only reads, so the GPU and the display can go on reading it too.
+  void CatchUp(Slot& slot) {
+    ScanoutStreamTexture* newest = slots_[newest_].texture.get();
+    if (!newest->Map(Access::READ))
+      return;
+    std::vector<PlaneFormat> plane_formats =
+        GetPlaneFormats(newest->GetFormat());
+    Dimension dimension = newest->GetDimension();
+    const Rect& stale = slot.stale;
+    for (size_t i = 0; i < plane_formats.size(); ++i) {
+      Dimension src_plane = newest->GetPlaneDimension(i);
+      Dimension dst_plane = slot.texture->GetPlaneDimension(i);
+      // Subsampled planes cover the rect rounded out.
+      int left = stale.x * src_plane.width / dimension.width;
+      int top = stale.y * src_plane.height / dimension.height;
+      int right = ((stale.x + stale.width) * src_plane.width +
+                   dimension.width - 1) /
+                  dimension.width;
+      int bottom = ((stale.y + stale.height) * src_plane.height +
+                    dimension.height - 1) /
+                   dimension.height;
+      size_t bytes_per_pixel = plane_formats[i].bytes_per_pixel;
+      const uint8_t* src =
+          static_cast<const uint8_t*>(newest->GetPlaneData(i)) +
+          top * src_plane.stride + left * bytes_per_pixel;
+      uint8_t* dst = static_cast<uint8_t*>(slot.texture->GetPlaneData(i)) +
+                     top * dst_plane.stride + left * bytes_per_pixel;
+      pixel::StreamBlit(dst, dst_plane.stride, src, src_plane.stride,
+                        (right - left) * bytes_per_pixel, bottom - top);
+    }
+    newest->Unmap();
+    // Without a dma_buf, it has to be uploaded as well.
+    slot.texture->MarkDirty(stale);
+    slot.stale = {0, 0, 0, 0};
+  }
+
+  void RetireSlot(int slot) {
+    if (!egl_->egl_sync_supported)
+      return;
+    slots_[slot].fence =
+        egl_->CreateSyncKHR(egl_->display, EGL_SYNC_FENCE_KHR, nullptr);
+  }
+
+  bool IsIdle(Slot& slot) {
+    if (slot.fence == EGL_NO_SYNC_KHR)
+      return true;
+    EGLint ret = egl_->ClientWaitSyncKHR(
+        egl_->display, slot.fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0);
+    if (ret == EGL_TIMEOUT_EXPIRED_KHR)
+      return false;
+    egl_->DestroySyncKHR(egl_->display, slot.fence);
+    slot.fence = EGL_NO_SYNC_KHR;
+    return true;
+  }
+
+  void WaitForIdle(Slot& slot) {
+    if (!egl_->egl_sync_supported) {
+      // Nothing tells when the GPU is done with the texture.
+      glFinish();
+      return;
+    }
+    if (slot.fence == EGL_NO_SYNC_KHR)
+      return;
+    egl_->ClientWaitSyncKHR(egl_->display, slot.fence,
+                            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+    egl_->DestroySyncKHR(egl_->display, slot.fence);
+    slot.fence = EGL_NO_SYNC_KHR;
+  }
+
+  const EGLGlue* const egl_;
+  std::vector<Slot> slots_;
+  int newest_ = 0;
+  int mapped_ = -1;
+  // what the mapped slot gets written
+  Rect dirty_ = {0, 0, 0, 0};
+};
+
+/*
+ * ImportedStreamTexture shows dma_bufs that another device fills, without a
+ * copy. Producers cycle through a few buffers, so the EGLImage, the GL
+ * texture and the framebuffer of each buffer are kept, and reused when it
+ * comes back. The fds are dup'ed, because the producer may close its own.
+ */
+class ImportedStreamTexture : public ScanoutStreamTexture {
  public:
-  Impl(std::unique_ptr<DRMModesetter> drm, const SwapBuffersCallback& callback)
-      : drm_(std::move(drm)), callback_(callback), egl_({}) {
-    drm_->SetClient(this);
+  // More than the queue of any camera or decoder needs.
+  static const size_t kMaxBuffers = 8;
+
+  static std::unique_ptr<ScanoutStreamTexture> Create(
+      const EGLGlue& egl,
+      int drm_fd,
+      const EGLDRMGlue::DmaBuf& dma_buf) {
+    std::unique_ptr<ImportedStreamTexture> texture(
+        new ImportedStreamTexture(egl, drm_fd));
+    if (texture->Import(dma_buf))
+      return std::move(texture);
+    return nullptr;
+  }
+
+  ~ImportedStreamTexture() override {
+    for (auto& buffer : buffers_)
+      DestroyBuffer(buffer.get());
+  }
+
+  bool Import(const EGLDRMGlue::DmaBuf& dma_buf) final {
+    if (dma_buf.planes.empty() || dma_buf.planes.size() > 4) {
+      fprintf(stderr, "a dma_buf has 1 to 4 planes.\n");
+      return false;
+    }
+    std::vector<BufferID> ids;
+    for (const EGLDRMGlue::DmaBuf::Plane& plane : dma_buf.planes) {
+      // The inode rules out most other dma_bufs cheaply, even if the
+      // producer exports a new fd every time.
+      struct stat st;
+      if (fstat(plane.fd, &st)) {
+        fprintf(stderr, "cannot stat dma_buf fd %d: %m\n", plane.fd);
+        return false;
+      }
+      ids.push_back(BufferID(st.st_dev, st.st_ino));
+    }
+
+    for (auto& buffer : buffers_) {
+      if (buffer->ids == ids && IsSameLayout(buffer->layout, dma_buf) &&
+          IsSameDmaBuf(buffer->layout, dma_buf)) {
+        buffer->last_use = ++use_count_;
+        current_ = buffer.get();
+        return true;
+      }
+    }
+
+    if (buffers_.size() >= kMaxBuffers && !EvictBuffer()) {
+      fprintf(stderr, "too many imported dma_bufs are on the screen.\n");
+      return false;
+    }
+    std::unique_ptr<Buffer> buffer = CreateBuffer(dma_buf, ids);
+    if (!buffer)
+      return false;
+    buffer->last_use = ++use_count_;
+    current_ = buffer.get();
+    std::lock_guard<std::mutex> lock(lock_);
+    buffers_.push_back(std::move(buffer));
+    return true;
+  }
+
+  // Only the GPU and the display read it.
+  void* Map(Access access, const Rect& rect) final { return nullptr; }
+  void MarkDirty(const Rect& rect) final {}
+  void Unmap() final {}
+
+  GLuint GetTextureID() const final { return current_->gl_tex; }
+
+  Dimension GetDimension() const final { return GetPlaneDimension(0); }
+
+  size_t GetPlaneCount() const final { return current_->layout.planes.size(); }
+
+  void* GetPlaneData(size_t plane) final { return nullptr; }
+
+  Dimension GetPlaneDimension(size_t plane) const final {
+    const BufferLayout& layout = current_->layout;
+    Dimension dimension;
+    dimension.width = layout.width;
+    dimension.height = layout.height;
+    dimension.stride = layout.planes[plane].stride;
+    std::vector<PlaneFormat> plane_formats = GetPlaneFormats(layout.format);
+    if (plane < plane_formats.size()) {
+      int subsampling = plane_formats[plane].subsampling;
+      dimension.width = (dimension.width + subsampling - 1) / subsampling;
+      dimension.height = (dimension.height + subsampling - 1) / subsampling;
+    }
+    return dimension;
+  }
+
+  bool IsExternal() const final {
+    return current_->target == GL_TEXTURE_EXTERNAL_OES;
+  }
+
+  uint32_t AcquireScanout() final {
+    std::lock_guard<std::mutex> lock(lock_);
+    Buffer* buffer = current_;
+    if (!buffer->fb_id && !buffer->add_fb_failed) {
+      if (drm_fd_ >= 0)
+        buffer->fb_id = AddImportedFramebuffer(drm_fd_, buffer->layout);
+      buffer->add_fb_failed = !buffer->fb_id;
+    }
+    if (buffer->fb_id)
+      ++buffer->scanout_count;
+    return buffer->fb_id;
+  }
+
+  bool ReleaseScanout(uint32_t fb_id) final {
+    if (!fb_id)
+      return false;
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& buffer : buffers_) {
+      if (buffer->fb_id != fb_id)
+        continue;
+      int count = buffer->scanout_count--;
+      assert(count > 0);
+      (void)count;
+      return true;
+    }
+    return false;
+  }
+
+  bool IsScanningOut() const final {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& buffer : buffers_) {
+      if (buffer->scanout_count > 0)
+        return true;
+    }
+    return false;
+  }
+
+  uint64_t GetModifier() const final { return current_->layout.modifier; }
+
+  uint32_t GetFormat() const final { return current_->layout.format; }
+
+ private:
+  typedef std::pair<dev_t, ino_t> BufferID;
+
+  struct Buffer {
+    // of the planes, to recognize the buffer when it comes back
+    std::vector<BufferID> ids;
+    // with our own fds
+    BufferLayout layout;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    GLuint gl_tex = 0;
+    GLenum target = GL_TEXTURE_2D;
+    uint32_t fb_id = 0;
+    bool add_fb_failed = false;
+    // how many flips show the buffer now or are about to
+    std::atomic<int> scanout_count{0};
+    uint64_t last_use = 0;
+  };
+
+  ImportedStreamTexture(const EGLGlue& egl, int drm_fd)
+      : egl_(&egl), drm_fd_(drm_fd) {}
+
+  static bool IsSameLayout(const BufferLayout& layout,
+                           const EGLDRMGlue::DmaBuf& dma_buf) {
+    if (layout.width != dma_buf.width || layout.height != dma_buf.height ||
+        layout.format != dma_buf.format ||
+        layout.modifier != dma_buf.modifier) {
+      return false;
+    }
+    for (size_t i = 0; i < layout.planes.size(); ++i) {
+      if (layout.planes[i].offset != dma_buf.planes[i].offset ||
+          layout.planes[i].stride != dma_buf.planes[i].stride) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Before Linux 5.3, every dma_buf shares the one inode of anon_inodefs, so
+  // only kcmp() tells whether the fds are of the same file.
+  static bool IsSameDmaBuf(const BufferLayout& layout,
+                           const EGLDRMGlue::DmaBuf& dma_buf) {
+    pid_t pid = getpid();
+    for (size_t i = 0; i < layout.planes.size(); ++i) {
+      int fd = dma_buf.planes[i].fd;
+      long ret = syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd,
+                         layout.planes[i].fd);
+      if (ret > 0)
+        return false;
+      if (ret == 0)
+        continue;
+      // Without kcmp(), e.g. CONFIG_KCMP off or a seccomp filter, the inode
+      // tells only if the dma_buf has one of its own. Otherwise don't reuse
+      // anything.
+      struct statfs st;
+      if (fstatfs(fd, &st) || st.f_type != kDmaBufMagic)
+        return false;
+    }
+    return true;
+  }
+
+  std::unique_ptr<Buffer> CreateBuffer(const EGLDRMGlue::DmaBuf& dma_buf,
+                                       const std::vector<BufferID>& ids) {
+    std::unique_ptr<Buffer> buffer(new Buffer());
+    buffer->ids = ids;
+    BufferLayout& layout = buffer->layout;
+    layout.width = dma_buf.width;
+    layout.height = dma_buf.height;
+    layout.format = dma_buf.format;
+    layout.modifier = dma_buf.modifier;
+    for (const EGLDRMGlue::DmaBuf::Plane& plane : dma_buf.planes) {
+      int fd = fcntl(plane.fd, F_DUPFD_CLOEXEC, 0);
+      if (fd < 0) {
+        fprintf(stderr, "cannot dup dma_buf fd %d: %m\n", plane.fd);
+        DestroyBuffer(buffer.get());
+        return nullptr;
+      }
+      layout.planes.push_back({fd, 0, plane.offset, plane.stride});
+    }
+
+    // YUV and the formats we don't know are left to the sampler to convert.
+    if (!GetFormatInfo(layout.format)) {
+      if (!egl_->external_texture_supported) {
+        fprintf(stderr, "GL_OES_EGL_image_external not supported\n");
+        DestroyBuffer(buffer.get());
+        return nullptr;
+      }
+      buffer->target = GL_TEXTURE_EXTERNAL_OES;
+    }
+
+    buffer->image = CreateImage(*egl_, layout);
+    if (buffer->image == EGL_NO_IMAGE_KHR) {
+      fprintf(stderr, "failed to import dma_buf: %s\n", EglGetError());
+      DestroyBuffer(buffer.get());
+      return nullptr;
+    }
+
+    GLenum target = buffer->target;
+    glGenTextures(1, &buffer->gl_tex);
+    glBindTexture(target, buffer->gl_tex);
+    egl_->EGLImageTargetTexture2DOES(target, buffer->image);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(target, 0);
+    return buffer;
   }
+
+  void DestroyBuffer(Buffer* buffer) {
+    assert(!buffer->scanout_count);
+    if (buffer->fb_id)
+      drmModeRmFB(drm_fd_, buffer->fb_id);
+    glDeleteTextures(1, &buffer->gl_tex);
+    if (buffer->image != EGL_NO_IMAGE_KHR)
+      egl_->DestroyImageKHR(egl_->display, buffer->image);
+    for (const BufferLayout::Plane& plane : buffer->layout.planes)
+      close(plane.fd);
+  }
+
+  // Drops the buffer shown the longest time ago that isn't on the screen,
+  // e.g. when the producer has reallocated its queue.
+  bool EvictBuffer() {
+    auto oldest = buffers_.end();
+    for (auto it = buffers_.begin(); it != buffers_.end(); ++it) {
+      Buffer* buffer = it->get();
+      if (buffer == current_ || buffer->scanout_count > 0)
+        continue;
+      if (oldest == buffers_.end() || buffer->last_use < (*oldest)->last_use)
+        oldest = it;
+    }
+    if (oldest == buffers_.end())
+      return false;
+
+    std::unique_ptr<Buffer> buffer;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      buffer = std::move(*oldest);
+      buffers_.erase(oldest);
+    }
+    DestroyBuffer(buffer.get());
+    return true;
+  }
+
+  const EGLGlue* const egl_;
+  const int drm_fd_;
+  // Only Import() changes it. The lock is for ReleaseScanout(), which the
+  // thread handling page flips calls.
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  mutable std::mutex lock_;
+  Buffer* current_ = nullptr;
+  uint64_t use_count_ = 0;
+};
+
+}  // namespace
+
+// static
+int StreamTexture::GetBytesPerPixel(uint32_t format) {
+  std::vector<PlaneFormat> plane_formats = GetPlaneFormats(format);
+  return plane_formats.empty() ? 0 : plane_formats[0].bytes_per_pixel;
+}
+
+void* StreamTexture::Map(Access access) {
+  Dimension dimension = GetDimension();
+  return Map(access, {0, 0, dimension.width, dimension.height});
+}
+
+class EGLDRMGlue::Impl {
+ public:
+  // Bounds the render queues, which are shared by every output.
+  static const size_t kMaxOutputs = 8;
+
+  Impl(std::unique_ptr<DRMModesetter> drm,
+       const SwapBuffersCallback& callback,
+       size_t num_buffers,
+       bool threaded,
+       const std::vector<uint32_t>& formats)
+      : drm_(std::move(drm)),
+        callback_(callback),
+        egl_({}),
+        formats_(formats),
+        num_buffers_(num_buffers),
+        threaded_(threaded) {}
   Impl(const Impl&) = delete;
   void operator=(const Impl&) = delete;
 
-  ~Impl() override {
-    /* destroy framebuffers */
-    for (auto& framebuffer : framebuffers_) {
-      glDeleteFramebuffers(1, &framebuffer.gl_fb);
-      glDeleteTextures(1, &framebuffer.gl_tex);
-      egl_.DestroyImageKHR(egl_.display, framebuffer.image);
-      drmModeRmFB(drm_->GetFD(), framebuffer.fb_id);
-      close(framebuffer.fd);
-      gbm_bo_destroy(framebuffer.bo);
+  ~Impl() {
+    DestroyOutputs();
+
+    if (overlay_program_)
+      glDeleteProgram(overlay_program_);
+    if (external_overlay_program_)
+      glDeleteProgram(external_overlay_program_);
+    eglDestroyContext(egl_.display, egl_.context);
+    eglTerminate(egl_.display);
+
+    if (gbm_)
+      gbm_device_destroy(gbm_);
+
+    if (render_wakeup_fd_ >= 0)
+      close(render_wakeup_fd_);
+  }
+
+  bool Initialize() {
+    // Headless without a render node renders into plain GL textures.
+    if (drm_->GetFD() >= 0) {
+      gbm_ = gbm_create_device(drm_->GetFD());
+      if (!gbm_) {
+        fprintf(stderr, "cannot create gbm device.\n");
+        return false;
+      }
+    }
+
+    if (!InitializeEGL()) {
+      fprintf(stderr, "cannot create EGL context.\n");
+      return false;
     }
 
-    eglDestroyContext(egl_.display, egl_.context);
-    eglTerminate(egl_.display);
+    explicit_fencing_ =
+        egl_.native_fence_supported && drm_->IsExplicitFencingSupported();
+    printf("explicit fencing: %s\n", explicit_fencing_ ? "on" : "off");
+
+    size_t num_outputs = drm_->GetOutputCount();
+    if (num_outputs > kMaxOutputs) {
+      fprintf(stderr, "only the first %zu of %zu outputs are used.\n",
+              kMaxOutputs, num_outputs);
+      num_outputs = kMaxOutputs;
+    }
+
+    // Without atomic modesetting, only adding the framebuffers tells whether
+    // the display takes the format.
+    for (uint32_t format : formats_) {
+      if (!IsFramebufferFormatSupported(format, num_outputs))
+        continue;
+      format_ = format;
+      if (CreateOutputs(num_outputs))
+        break;
+      DestroyOutputs();
+      format_ = 0;
+    }
+    if (!format_) {
+      fprintf(stderr, "no framebuffer format is supported.\n");
+      return false;
+    }
+    printf("framebuffer format: %.4s\n",
+           reinterpret_cast<const char*>(&format_));
+    for (auto& output : outputs_) {
+      drm_->SetClient(output->index, output.get());
+      if (output->modifier != DRM_FORMAT_MOD_INVALID) {
+        printf("output %zu: modifier 0x%016" PRIx64 "\n", output->index,
+               output->modifier);
+      }
+    }
+
+    // The first mode setting shows the scanout buffer, which nothing draws.
+    ClearScanoutBuffers();
+
+    // Need to do the first mode setting before page flip.
+    if (!drm_->ModeSetCrtc())
+      return false;
+
+    if (threaded_) {
+      render_wakeup_fd_ = eventfd(0, EFD_CLOEXEC);
+      if (render_wakeup_fd_ < 0) {
+        fprintf(stderr, "cannot create eventfd: %m\n");
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool Run() {
+    if (threaded_)
+      return RunThreaded();
 
-    gbm_device_destroy(gbm_);
+    // Fill the swapchains before the first page flip.
+    for (auto& output : outputs_)
+      DrawFrames(*output);
+    return drm_->Run();
   }
 
-  bool Initialize() {
-    gbm_ = gbm_create_device(drm_->GetFD());
+  void Stop() { drm_->Stop(); }
+  EventLoop* GetEventLoop() { return drm_->GetEventLoop(); }
+  size_t GetOutputCount() const { return outputs_.size(); }
+  FrameStats* GetFrameStats(size_t output) { return &outputs_[output]->stats; }
+
+  /*
+   * In the threaded mode, the render thread owns the EGL context and the
+   * calling thread only deals with KMS events. The swapchains stay on the KMS
+   * thread: it hands free buffers over to the render thread through
+   * |free_queue_|, and gets them back through |ready_queue_| when they are
+   * rendered. A slow frame therefore never delays page flip events. Every
+   * output shares the queues, and frames are drawn in the order their
+   * buffers become free.
+   */
+  bool RunThreaded() {
+    // The render thread takes over the EGL context.
+    eglMakeCurrent(egl_.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    quit_render_thread_ = false;
+    render_thread_failed_ = false;
+    std::thread render_thread(&Impl::RenderThreadMain, this);
+
+    for (auto& output : outputs_)
+      DrawFrames(*output);
+    bool ret = drm_->Run();
+
+    quit_render_thread_ = true;
+    WakeupRenderThread();
+    render_thread.join();
+
+    // Give the context back to the caller, who is going to destroy GL
+    // resources.
+    eglMakeCurrent(egl_.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_.context);
+    return ret && !render_thread_failed_;
+  }
+
+  Size GetDisplaySize(size_t output) const {
+    DRMModesetter::Size display_size = outputs_[output]->size;
+    return {display_size.width, display_size.height};
+  }
+
+  uint32_t GetFormat() const { return format_; }
+  size_t GetNumBuffers() const { return num_buffers_; }
+  bool IsThreaded() const { return threaded_; }
+
+  // Only GBM and EGL have a say; overlay planes are checked when attached.
+  bool IsStreamTextureFormatSupported(uint32_t format) {
+    std::vector<PlaneFormat> plane_formats = GetPlaneFormats(format);
+    if (plane_formats.empty())
+      return false;
     if (!gbm_) {
-      fprintf(stderr, "cannot create gbm device.\n");
+      const FormatInfo* info = GetFormatInfo(format);
+      return info && info->gl_format;
+    }
+    if (plane_formats.size() > 1 && !egl_.external_texture_supported)
       return false;
+    for (const PlaneFormat& plane_format : plane_formats) {
+      if (!gbm_device_is_format_supported(gbm_, plane_format.format,
+                                          GBM_BO_USE_LINEAR)) {
+        return false;
+      }
     }
+    return IsImportSupported(format);
+  }
 
-    if (!InitializeEGL()) {
-      fprintf(stderr, "cannot create EGL context.\n");
-      return false;
+  std::unique_ptr<ScanoutStreamTexture> CreateStreamTexture(size_t width,
+                                                            size_t height,
+                                                            uint32_t format) {
+    if (!gbm_)
+      return HostStreamTextureImpl::Create(egl_, format, width, height);
+    // A render node can't add framebuffers, and without scanout memory
+    // there's nothing to add them for.
+    int drm_fd =
+        drm_->IsHeadless() || !scanout_stream_textures_ ? -1 : drm_->GetFD();
+    bool explicit_modifier = drm_fd >= 0 && drm_->IsModifierSupported() &&
+                             egl_.modifiers_supported;
+    return StreamTextureImpl::Create(gbm_, egl_, drm_fd, explicit_modifier,
+                                     format, width, height,
+                                     detect_mapping_reads_);
+  }
+
+  std::unique_ptr<StreamTexture> CreateStreamTexture(size_t width,
+                                                     size_t height,
+                                                     size_t num_slots,
+                                                     uint32_t format) {
+    if (num_slots < 1 || num_slots > StreamTextureRing::kMaxSlots) {
+      fprintf(stderr, "the number of slots must be between 1 and %zu.\n",
+              StreamTextureRing::kMaxSlots);
+      return nullptr;
+    }
+    if (!IsStreamTextureFormatSupported(format)) {
+      fprintf(stderr, "unsupported stream texture format %.4s.\n",
+              reinterpret_cast<const char*>(&format));
+      return nullptr;
+    }
+    if (num_slots == 1)
+      return CreateStreamTexture(width, height, format);
+
+    std::vector<std::unique_ptr<ScanoutStreamTexture>> slots;
+    for (size_t i = 0; i < num_slots; ++i) {
+      std::unique_ptr<ScanoutStreamTexture> slot =
+          CreateStreamTexture(width, height, format);
+      if (!slot)
+        return nullptr;
+      slots.push_back(std::move(slot));
     }
+    return StreamTextureRing::Create(egl_, std::move(slots));
+  }
 
-    DRMModesetter::Size display_size = drm_->GetDisplaySize();
-    for (auto& framebuffer : framebuffers_) {
-      if (!CreateFramebuffer(display_size.width, display_size.height,
-                             framebuffer)) {
-        fprintf(stderr, "cannot create framebuffer.\n");
-        return false;
-      }
+  std::unique_ptr<ScanoutStreamTexture> ImportStreamTexture(
+      const EGLDRMGlue::DmaBuf& dma_buf) {
+    if (!egl_.dma_buf_import_supported) {
+      fprintf(stderr, "EGL_EXT_image_dma_buf_import extension not supported\n");
+      return nullptr;
     }
+    // A render node can't add framebuffers.
+    int drm_fd = drm_->IsHeadless() ? -1 : drm_->GetFD();
+    return ImportedStreamTexture::Create(egl_, drm_fd, dma_buf);
+  }
 
-    // Need to do the first mode setting before page flip.
-    if (!drm_->ModeSetCrtc())
+  // Every texture comes from CreateStreamTexture() or ImportStreamTexture(),
+  // so it's a ScanoutStreamTexture.
+  bool ImportStreamTexture(StreamTexture* texture,
+                           const EGLDRMGlue::DmaBuf& dma_buf) {
+    if (!static_cast<ScanoutStreamTexture*>(texture)->Import(dma_buf)) {
+      fprintf(stderr, "failed to import a dma_buf into the texture.\n");
       return false;
-
+    }
     return true;
   }
 
-  bool Run() { return drm_->Run(); }
+  void SetDetectMappingReads(bool detect) { detect_mapping_reads_ = detect; }
+  void SetScanoutStreamTextures(bool scanout) {
+    scanout_stream_textures_ = scanout;
+  }
+  void SetRenderLate(bool render_late) { render_late_ = render_late; }
+
+  bool AttachOverlay(StreamTexture* texture,
+                     size_t output,
+                     const Rect& dst,
+                     int zpos) {
+    DetachOverlay(texture);
+    OverlayAttachment attachment;
+    attachment.texture = static_cast<ScanoutStreamTexture*>(texture);
+    attachment.dst = dst;
+    attachment.zpos = zpos;
+    attachment.plane = FindOverlayPlane(output, attachment);
+
+    // Keep them sorted by |zpos|, which is the order GL draws them in.
+    std::vector<OverlayAttachment>& overlays = outputs_[output]->overlays;
+    auto it = overlays.begin();
+    while (it != overlays.end() && it->zpos <= zpos)
+      ++it;
+    overlays.insert(it, attachment);
+    return attachment.plane != -1;
+  }
+
+  void AddDamage(size_t output, const Rect& rect) {
+    outputs_[output]->damage_added = true;
+    AddDamageRect(&outputs_[output]->damage, rect);
+  }
 
-  Size GetDisplaySize() const {
-    DRMModesetter::Size display_size = drm_->GetDisplaySize();
-    return {display_size.width, display_size.height};
+  Rect GetBufferDamage(size_t output) const {
+    return outputs_[output]->buffer_damage;
   }
 
-  std::unique_ptr<StreamTexture> CreateStreamTexture(size_t width,
-                                                     size_t height) {
-    return StreamTextureImpl::Create(gbm_, egl_, width, height);
+  void DetachOverlay(StreamTexture* texture) {
+    for (auto& output : outputs_) {
+      std::vector<OverlayAttachment>& overlays = output->overlays;
+      for (auto it = overlays.begin(); it != overlays.end(); ++it) {
+        if (it->texture != texture)
+          continue;
+        if (it->plane != -1)
+          drm_->FreeOverlayPlane(it->plane);
+        overlays.erase(it);
+        break;
+      }
+    }
   }
 
  private:
@@ -278,8 +1655,15 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
             "glEGLImageTargetTexture2DOES");
     egl_.CreateSyncKHR =
         (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    egl_.DestroySyncKHR =
+        (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
     egl_.ClientWaitSyncKHR =
         (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    egl_.WaitSyncKHR =
+        (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+    egl_.DupNativeFenceFDANDROID =
+        (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress(
+            "eglDupNativeFenceFDANDROID");
     if (!egl_.CreateImageKHR || !egl_.DestroyImageKHR ||
         !egl_.EGLImageTargetTexture2DOES) {
       fprintf(
@@ -288,13 +1672,17 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
           "point.\n");
       return false;
     }
-    if (egl_.CreateSyncKHR && egl_.ClientWaitSyncKHR) {
+    if (egl_.CreateSyncKHR && egl_.DestroySyncKHR && egl_.ClientWaitSyncKHR) {
       egl_.egl_sync_supported = true;
     } else {
       egl_.egl_sync_supported = false;
     }
 
-    egl_.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_.display = EGL_NO_DISPLAY;
+    if (drm_->IsHeadless())
+      egl_.display = GetSurfacelessDisplay();
+    if (egl_.display == EGL_NO_DISPLAY)
+      egl_.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 
     EGLint major, minor = 0;
     if (!eglInitialize(egl_.display, &major, &minor)) {
@@ -346,31 +1734,128 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
       fprintf(stderr, "EGL_KHR_image_base extension not supported\n");
       return false;
     }
-    if (!ExtensionsContain("EGL_EXT_image_dma_buf_import", egl_extensions)) {
+    egl_.dma_buf_import_supported =
+        ExtensionsContain("EGL_EXT_image_dma_buf_import", egl_extensions);
+    if (gbm_ && !egl_.dma_buf_import_supported) {
       fprintf(stderr, "EGL_EXT_image_dma_buf_import extension not supported\n");
       return false;
     }
 
+    if (ExtensionsContain("EGL_EXT_image_dma_buf_import_modifiers",
+                          egl_extensions)) {
+      egl_.QueryDmaBufFormatsEXT =
+          (PFNEGLQUERYDMABUFFORMATSEXTPROC)eglGetProcAddress(
+              "eglQueryDmaBufFormatsEXT");
+      egl_.QueryDmaBufModifiersEXT =
+          (PFNEGLQUERYDMABUFMODIFIERSEXTPROC)eglGetProcAddress(
+              "eglQueryDmaBufModifiersEXT");
+      egl_.modifiers_supported =
+          egl_.QueryDmaBufFormatsEXT && egl_.QueryDmaBufModifiersEXT;
+    }
+
+    egl_.native_fence_supported =
+        egl_.egl_sync_supported && egl_.WaitSyncKHR &&
+        egl_.DupNativeFenceFDANDROID &&
+        ExtensionsContain("EGL_ANDROID_native_fence_sync", egl_extensions) &&
+        ExtensionsContain("EGL_KHR_wait_sync", egl_extensions);
+
     const char* gl_extensions = (const char*)glGetString(GL_EXTENSIONS);
-    if (!ExtensionsContain("GL_OES_EGL_image", gl_extensions)) {
+    if (gbm_ && !ExtensionsContain("GL_OES_EGL_image", gl_extensions)) {
       fprintf(stderr, "GL_OES_EGL_image extension not supported\n");
       return false;
     }
+    egl_.bgra_texture_supported =
+        ExtensionsContain("GL_EXT_texture_format_BGRA8888", gl_extensions);
+    egl_.external_texture_supported =
+        ExtensionsContain("GL_OES_EGL_image_external", gl_extensions);
+
+    if (ExtensionsContain("GL_EXT_disjoint_timer_query", gl_extensions)) {
+      egl_.GenQueriesEXT =
+          (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+      egl_.DeleteQueriesEXT =
+          (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+      egl_.BeginQueryEXT =
+          (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+      egl_.EndQueryEXT =
+          (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+      egl_.GetQueryObjectuivEXT = (PFNGLGETQUERYOBJECTUIVEXTPROC)
+          eglGetProcAddress("glGetQueryObjectuivEXT");
+      egl_.GetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC)
+          eglGetProcAddress("glGetQueryObjectui64vEXT");
+      egl_.timer_query_supported =
+          egl_.GenQueriesEXT && egl_.DeleteQueriesEXT && egl_.BeginQueryEXT &&
+          egl_.EndQueryEXT && egl_.GetQueryObjectuivEXT &&
+          egl_.GetQueryObjectui64vEXT;
+    }
+    printf("GPU timer query: %s\n", egl_.timer_query_supported ? "on" : "off");
 
     return true;
   }
 
+  // EGL_MESA_platform_surfaceless needs neither a display nor a device, so it
+  // works on build servers too.
+  EGLDisplay GetSurfacelessDisplay() {
+    const char* client_extensions =
+        eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (!ExtensionsContain("EGL_EXT_platform_base", client_extensions) ||
+        !ExtensionsContain("EGL_MESA_platform_surfaceless",
+                           client_extensions)) {
+      return EGL_NO_DISPLAY;
+    }
+    PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+            "eglGetPlatformDisplayEXT");
+    if (!GetPlatformDisplayEXT)
+      return EGL_NO_DISPLAY;
+    return GetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, nullptr);
+  }
+
   void EGLSyncFence() {
     if (egl_.egl_sync_supported) {
       EGLSyncKHR sync =
           egl_.CreateSyncKHR(egl_.display, EGL_SYNC_FENCE_KHR, nullptr);
       glFlush();
       egl_.ClientWaitSyncKHR(egl_.display, sync, 0, EGL_FOREVER_KHR);
+      egl_.DestroySyncKHR(egl_.display, sync);
     } else {
       glFinish();
     }
   }
 
+  // Returns a sync_file fd that signals when the GPU finishes the commands
+  // issued so far, or -1. Nothing waits here; the kernel waits for the fd
+  // before scanning out the buffer.
+  int CreateRenderFence() {
+    EGLSyncKHR sync = egl_.CreateSyncKHR(
+        egl_.display, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+    if (sync == EGL_NO_SYNC_KHR)
+      return -1;
+    // The fence fd is created when the commands are flushed.
+    glFlush();
+    int fd = egl_.DupNativeFenceFDANDROID(egl_.display, sync);
+    egl_.DestroySyncKHR(egl_.display, sync);
+    return fd == EGL_NO_NATIVE_FENCE_FD_ANDROID ? -1 : fd;
+  }
+
+  // Makes the GPU, not the CPU, wait until the display releases the buffer.
+  void WaitForRelease(int release_fence_fd) {
+    const EGLint attribs[] = {EGL_SYNC_NATIVE_FENCE_FD_ANDROID,
+                              release_fence_fd, EGL_NONE};
+    EGLSyncKHR sync = egl_.CreateSyncKHR(
+        egl_.display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+    if (sync == EGL_NO_SYNC_KHR) {
+      // EGL didn't take the fd, so fall back to waiting on the CPU.
+      pollfd fds = {release_fence_fd, POLLIN, 0};
+      poll(&fds, 1, -1);
+      close(release_fence_fd);
+      return;
+    }
+    // Now EGL owns the fd.
+    egl_.WaitSyncKHR(egl_.display, sync, 0);
+    egl_.DestroySyncKHR(egl_.display, sync);
+  }
+
   bool ExtensionsContain(const char* name, const char* c_extensions) {
     assert(name);
     if (!c_extensions)
@@ -384,18 +1869,237 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
     return extensions.find(delimited_name) != std::string::npos;
   }
 
+  struct OverlayAttachment {
+    ScanoutStreamTexture* texture = nullptr;
+    Rect dst = {};
+    int zpos = 0;
+    // the overlay plane, or -1 if GL draws the texture into the framebuffer
+    int plane = -1;
+  };
+
+  // A framebuffer of a texture that the display scans out or is about to.
+  struct ScanoutRef {
+    ScanoutStreamTexture* texture;
+    uint32_t fb_id;
+  };
+
   struct Framebuffer {
     struct gbm_bo* bo = nullptr;
-    int fd;
-    uint32_t fb_id;
-    EGLImageKHR image;
-    GLuint gl_tex;
-    GLuint gl_fb;
+    int fd = -1;
+    uint32_t fb_id = 0;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    GLuint gl_tex = 0;
+    GLuint gl_fb = 0;
+    // signals when the GPU finishes rendering into this buffer
+    int render_fence_fd = -1;
+    // signals when the display stops scanning out this buffer
+    int release_fence_fd = -1;
+    // measures the GPU time of the last frame drawn into this buffer
+    GLuint gpu_query = 0;
+    bool gpu_query_pending = false;
+    // what goes on the overlay planes with this buffer
+    std::vector<DRMModesetter::Overlay> overlays;
+    std::vector<ScanoutRef> scanout_refs;
+    // the frame drawn into this buffer last, or 0 if none was
+    uint64_t frame = 0;
+    // where GL drew overlays over it
+    Rect composited = {0, 0, 0, 0};
+    // what it changes on the screen, or empty if everything
+    std::vector<DRMModesetter::Rect> damage;
+    // when the KMS thread handed it over to be drawn
+    uint64_t draw_scheduled = 0;
+    // when |callback_| started drawing it
+    uint64_t draw_start = 0;
+    // the GPU time of the last frame drawn into it, or 0
+    uint64_t gpu_usec = 0;
+    // the VBlank the frame in it is predicted to be shown on, or 0
+    uint64_t predicted_sequence = 0;
+  };
+
+  // Frames older than that count as all damaged.
+  static const size_t kDamageHistory = 8;
+  // More rects cost the display more than they save.
+  static const size_t kMaxDamageRects = 8;
+
+  // Everything of one display. The modesetter calls it back for the page
+  // flips of its CRTC only.
+  struct Output : public DRMModesetter::Client {
+    Output(Impl* impl, size_t index, size_t num_buffers)
+        : impl(impl),
+          index(index),
+          framebuffers(num_buffers),
+          swapchain(num_buffers) {}
+
+    void DidPageFlip(int front_buffer,
+                     uint64_t sequence,
+                     uint64_t nsec) override {
+      impl->DidPageFlip(*this, front_buffer, sequence, nsec);
+    }
+    uint32_t GetFrameBuffer(int front_buffer) const override {
+      return framebuffers[front_buffer].fb_id;
+    }
+    int GetQueuedBuffer() override { return impl->GetQueuedBuffer(*this); }
+    int TakeRenderFence(int buffer) override {
+      int fd = framebuffers[buffer].render_fence_fd;
+      framebuffers[buffer].render_fence_fd = -1;
+      return fd;
+    }
+    std::vector<DRMModesetter::Overlay> TakeOverlays(int buffer) override {
+      Framebuffer& framebuffer = framebuffers[buffer];
+      pending_scanout.insert(pending_scanout.end(),
+                             framebuffer.scanout_refs.begin(),
+                             framebuffer.scanout_refs.end());
+      framebuffer.scanout_refs.clear();
+      return std::move(framebuffer.overlays);
+    }
+    std::vector<DRMModesetter::Rect> TakeDamage(int buffer) override {
+      return std::move(framebuffers[buffer].damage);
+    }
+    void DidCommitPageFlip(int release_fence_fd) override {
+      impl->DidCommitPageFlip(*this, release_fence_fd);
+    }
+
+    Impl* const impl;
+    const size_t index;
+    DRMModesetter::Size size = {};
+    std::vector<Framebuffer> framebuffers;
+    // of the framebuffers, if it was picked explicitly
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    // Only touched on the KMS thread.
+    Swapchain swapchain;
+    FramePacer pacer;
+    // fires when it's time to draw the next frame with |render_late_|
+    int pacing_timer = -1;
+    uint64_t last_flip_ns = 0;
+    uint64_t last_flip_sequence = 0;
+    uint64_t missed_frames = 0;
+    FrameStats stats;
+    // Only touched on the thread calling |callback_|.
+    std::vector<OverlayAttachment> overlays;
+    uint64_t frame_count = 0;
+    // from AddDamage() for the frame being drawn
+    std::vector<Rect> damage;
+    bool damage_added = false;
+    Rect buffer_damage = {0, 0, 0, 0};
+    Rect last_composited = {0, 0, 0, 0};
+    // the bounds of the damage of the recent frames, by frame number
+    Rect damage_history[kDamageHistory] = {};
+    // The textures on the overlay planes now, and after the pending flip.
+    // Only touched on the KMS thread.
+    std::vector<ScanoutRef> on_screen_scanout;
+    std::vector<ScanoutRef> pending_scanout;
   };
 
-  bool CreateFramebuffer(int width, int height, Framebuffer& framebuffer) {
-    framebuffer.bo = gbm_bo_create(gbm_, width, height, GBM_FORMAT_XRGB8888,
-                                   GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+  // The framebuffers need a format that the primary planes scan out, GBM
+  // allocates for rendering and EGL imports. Only creating them tells for
+  // sure whether the GPU renders to it.
+  bool IsFramebufferFormatSupported(uint32_t format, size_t num_outputs) {
+    const FormatInfo* info = GetFormatInfo(format);
+    if (!info)
+      return false;
+    if (!gbm_)
+      return info->gl_format;
+
+    uint32_t usage = GBM_BO_USE_RENDERING;
+    if (!drm_->IsHeadless())
+      usage |= GBM_BO_USE_SCANOUT;
+    if (!gbm_device_is_format_supported(gbm_, format, usage) ||
+        !IsImportSupported(format)) {
+      return false;
+    }
+    for (size_t i = 0; i < num_outputs; ++i) {
+      if (!drm_->IsFormatSupported(i, format))
+        return false;
+    }
+    return true;
+  }
+
+  // Without EGL_EXT_image_dma_buf_import_modifiers, only importing tells.
+  bool IsImportSupported(uint32_t format) {
+    if (!egl_.modifiers_supported)
+      return true;
+    EGLint count = 0;
+    if (!egl_.QueryDmaBufFormatsEXT(egl_.display, 0, nullptr, &count) ||
+        count <= 0) {
+      return false;
+    }
+    std::vector<EGLint> formats(count);
+    if (!egl_.QueryDmaBufFormatsEXT(egl_.display, count, formats.data(),
+                                    &count)) {
+      return false;
+    }
+    return std::find(formats.begin(), formats.begin() + count,
+                     static_cast<EGLint>(format)) != formats.begin() + count;
+  }
+
+  // The modifiers of |format| that the primary plane of |output| scans out
+  // and the GPU renders to. Empty if either side doesn't list them, and then
+  // the driver picks the layout implicitly.
+  std::vector<uint64_t> GetScanoutModifiers(size_t output, uint32_t format) {
+    if (!gbm_ || drm_->IsHeadless() || !egl_.modifiers_supported)
+      return {};
+    std::vector<uint64_t> scanout = drm_->GetModifiers(output, format);
+    EGLint count = 0;
+    if (scanout.empty() ||
+        !egl_.QueryDmaBufModifiersEXT(egl_.display, format, 0, nullptr,
+                                      nullptr, &count) ||
+        count <= 0) {
+      return {};
+    }
+    std::vector<EGLuint64KHR> renderable(count);
+    std::vector<EGLBoolean> external_only(count);
+    if (!egl_.QueryDmaBufModifiersEXT(egl_.display, format, count,
+                                      renderable.data(), external_only.data(),
+                                      &count)) {
+      return {};
+    }
+
+    std::vector<uint64_t> modifiers;
+    for (EGLint i = 0; i < count; ++i) {
+      // Those can only be sampled as GL_TEXTURE_EXTERNAL_OES, not rendered.
+      if (external_only[i])
+        continue;
+      if (std::find(scanout.begin(), scanout.end(), renderable[i]) !=
+          scanout.end()) {
+        modifiers.push_back(renderable[i]);
+      }
+    }
+    return modifiers;
+  }
+
+  // GBM picks the best of |modifiers|, e.g. a compressed layout over a tiled
+  // one over linear.
+  bool CreateFramebuffer(int width,
+                         int height,
+                         const std::vector<uint64_t>& modifiers,
+                         Framebuffer& framebuffer) {
+    if (!gbm_) {
+      // BGRA isn't always renderable, and the order doesn't matter here.
+      const FormatInfo* info = GetFormatInfo(format_);
+      GLenum gl_format =
+          info->gl_format == GL_BGRA_EXT ? GL_RGBA : info->gl_format;
+      glGenTextures(1, &framebuffer.gl_tex);
+      glBindTexture(GL_TEXTURE_2D, framebuffer.gl_tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, gl_format, width, height, 0, gl_format,
+                   info->gl_type, nullptr);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      return CreateGLFramebuffer(framebuffer);
+    }
+
+    // A render node can't scan out, and has no framebuffer object to add.
+    bool headless = drm_->IsHeadless();
+    uint32_t usage = GBM_BO_USE_RENDERING;
+    if (!headless)
+      usage |= GBM_BO_USE_SCANOUT;
+    bool explicit_modifier = !modifiers.empty();
+    if (explicit_modifier) {
+      framebuffer.bo = gbm_bo_create_with_modifiers(
+          gbm_, width, height, format_, modifiers.data(), modifiers.size());
+    }
+    if (!framebuffer.bo) {
+      explicit_modifier = false;
+      framebuffer.bo = gbm_bo_create(gbm_, width, height, format_, usage);
+    }
     if (!framebuffer.bo) {
       fprintf(stderr, "failed to create a gbm buffer.\n");
       return false;
@@ -407,33 +2111,17 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
       return false;
     }
 
-    uint32_t handle = gbm_bo_get_handle(framebuffer.bo).u32;
-    uint32_t stride = gbm_bo_get_stride(framebuffer.bo);
-    uint32_t offset = 0;
-    drmModeAddFB2(drm_->GetFD(), width, height, GBM_FORMAT_XRGB8888, &handle,
-                  &stride, &offset, &framebuffer.fb_id, 0);
-    if (!framebuffer.fb_id) {
+    BufferLayout layout = GetLayout(framebuffer.bo, framebuffer.fd, format_,
+                                    explicit_modifier);
+    if (!headless) {
+      framebuffer.fb_id = AddFramebuffer(drm_->GetFD(), layout);
+    }
+    if (!headless && !framebuffer.fb_id) {
       fprintf(stderr, "failed to create framebuffer from buffer object.\n");
       return false;
     }
 
-    const EGLint khr_image_attrs[] = {EGL_DMA_BUF_PLANE0_FD_EXT,
-                                      framebuffer.fd,
-                                      EGL_WIDTH,
-                                      width,
-                                      EGL_HEIGHT,
-                                      height,
-                                      EGL_LINUX_DRM_FOURCC_EXT,
-                                      GBM_FORMAT_XRGB8888,
-                                      EGL_DMA_BUF_PLANE0_PITCH_EXT,
-                                      static_cast<const int>(stride),
-                                      EGL_DMA_BUF_PLANE0_OFFSET_EXT,
-                                      static_cast<const int>(offset),
-                                      EGL_NONE};
-
-    framebuffer.image =
-        egl_.CreateImageKHR(egl_.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
-                            nullptr /* no client buffer */, khr_image_attrs);
+    framebuffer.image = CreateImage(egl_, layout);
     if (framebuffer.image == EGL_NO_IMAGE_KHR) {
       fprintf(stderr, "failed to make image from buffer object: %s\n",
               EglGetError());
@@ -444,7 +2132,10 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
     glBindTexture(GL_TEXTURE_2D, framebuffer.gl_tex);
     egl_.EGLImageTargetTexture2DOES(GL_TEXTURE_2D, framebuffer.image);
     glBindTexture(GL_TEXTURE_2D, 0);
+    return CreateGLFramebuffer(framebuffer);
+  }
 
+  bool CreateGLFramebuffer(Framebuffer& framebuffer) {
     glGenFramebuffers(1, &framebuffer.gl_fb);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.gl_fb);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
@@ -456,25 +2147,656 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
               glCheckFramebufferStatus(GL_FRAMEBUFFER));
       glDeleteFramebuffers(1, &framebuffer.gl_fb);
       glDeleteTextures(1, &framebuffer.gl_tex);
+      framebuffer.gl_fb = 0;
+      framebuffer.gl_tex = 0;
       return false;
     }
 
     return true;
   }
 
-  // As soon as page flip, notify the client to draw the next frame.
-  void DidPageFlip(int front_buffer,
-                   unsigned int sec,
-                   unsigned int usec) override {
-    const Framebuffer& back_fb = framebuffers_[front_buffer ^ 1];
+  // The context is new, so the clear color is still the default black.
+  void ClearScanoutBuffers() {
+    for (auto& output : outputs_) {
+      int buffer = output->swapchain.GetScanoutBuffer();
+      glBindFramebuffer(GL_FRAMEBUFFER, output->framebuffers[buffer].gl_fb);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    EGLSyncFence();
+  }
+
+  // Makes the framebuffers of |format_| for every output.
+  bool CreateOutputs(size_t num_outputs) {
+    for (size_t i = 0; i < num_outputs; ++i) {
+      std::unique_ptr<Output> output(new Output(this, i, num_buffers_));
+      output->size = drm_->GetDisplaySize(i);
+      output->stats.SetRefreshInterval(drm_->GetRefreshInterval(i));
+      output->pacer.SetRefreshInterval(drm_->GetRefreshInterval(i));
+      // Added first, so that DestroyOutputs() frees what a failure leaves.
+      Output* raw_output = output.get();
+      outputs_.push_back(std::move(output));
+      std::vector<uint64_t> modifiers = GetScanoutModifiers(i, format_);
+      for (auto& framebuffer : raw_output->framebuffers) {
+        if (!CreateFramebuffer(raw_output->size.width,
+                               raw_output->size.height, modifiers,
+                               framebuffer)) {
+          fprintf(stderr, "cannot create %.4s framebuffer.\n",
+                  reinterpret_cast<const char*>(&format_));
+          return false;
+        }
+      }
+      if (!modifiers.empty()) {
+        raw_output->modifier =
+            gbm_bo_get_modifier(raw_output->framebuffers[0].bo);
+      }
+    }
+    return true;
+  }
+
+  void DestroyOutputs() {
+    for (auto& output : outputs_) {
+      if (output->pacing_timer >= 0)
+        drm_->GetEventLoop()->Remove(output->pacing_timer);
+      for (auto& framebuffer : output->framebuffers)
+        DestroyFramebuffer(framebuffer);
+    }
+    outputs_.clear();
+  }
+
+  void DestroyFramebuffer(Framebuffer& framebuffer) {
+    if (framebuffer.render_fence_fd >= 0)
+      close(framebuffer.render_fence_fd);
+    if (framebuffer.release_fence_fd >= 0)
+      close(framebuffer.release_fence_fd);
+    if (framebuffer.gpu_query)
+      egl_.DeleteQueriesEXT(1, &framebuffer.gpu_query);
+    glDeleteFramebuffers(1, &framebuffer.gl_fb);
+    glDeleteTextures(1, &framebuffer.gl_tex);
+    if (framebuffer.image)
+      egl_.DestroyImageKHR(egl_.display, framebuffer.image);
+    if (framebuffer.fb_id)
+      drmModeRmFB(drm_->GetFD(), framebuffer.fb_id);
+    if (framebuffer.fd >= 0)
+      close(framebuffer.fd);
+    if (framebuffer.bo)
+      gbm_bo_destroy(framebuffer.bo);
+    framebuffer = Framebuffer();
+  }
+
+  // Let the client draw into every free buffer. In the steady state, a page
+  // flip frees exactly one buffer, so one frame is drawn per VBlank.
+  void DrawFrames(Output& output) {
+    while (output.swapchain.HasFreeBuffer() && !DeferFrame(output)) {
+      FrameTiming timing = PredictTiming(output);
+      int buffer = output.swapchain.AcquireBuffer();
+      Framebuffer& framebuffer = output.framebuffers[buffer];
+      framebuffer.draw_scheduled = NowInUsec();
+      framebuffer.predicted_sequence = timing.sequence;
+      if (threaded_) {
+        bool pushed = free_queue_.Push({&output, buffer, timing});
+        assert(pushed);
+        (void)pushed;
+        WakeupRenderThread();
+        continue;
+      }
+      DrawFrame(output, buffer, timing);
+      output.swapchain.QueueBuffer(buffer);
+      DidDrawFrame(output, buffer);
+    }
+  }
+
+  // The frame drawn next goes out after the ones drawn or flipped already.
+  FrameTiming PredictTiming(const Output& output) {
+    uint64_t now = NowInUsec();
+    size_t frames_ahead = output.swapchain.GetFramesAhead();
+    uint64_t period = output.pacer.GetRefreshInterval();
+    FrameTiming timing;
+    timing.last_flip_ns = output.last_flip_ns;
+    timing.last_flip_sequence = output.last_flip_sequence;
+    timing.refresh_ns = period * 1000;
+    timing.missed_frames = output.missed_frames;
+
+    uint64_t presentation =
+        output.pacer.GetPresentationTime(now, frames_ahead);
+    if (!presentation) {
+      // Either no flip yet, or every flip is a VBlank of its own. The
+      // frames priming the swapchain still go out a period apart.
+      timing.presentation_ns =
+          (now + output.pacer.GetPredictedCost() + frames_ahead * period) *
+          1000;
+      if (output.last_flip_ns)
+        timing.sequence = output.last_flip_sequence + frames_ahead + 1;
+      return timing;
+    }
+    timing.presentation_ns = presentation * 1000;
+    uint64_t last_flip = output.last_flip_ns / 1000;
+    timing.sequence = output.last_flip_sequence +
+                      (presentation - last_flip + period / 2) / period;
+    return timing;
+  }
+
+  // With |render_late_|, puts the next frame off until the predicted start,
+  // and returns true if it did.
+  bool DeferFrame(Output& output) {
+    if (!render_late_)
+      return false;
+    uint64_t now = NowInUsec();
+    uint64_t start = output.pacer.GetRenderStart(
+        now, output.swapchain.GetFramesAhead());
+    if (start <= now)
+      return false;
+
+    EventLoop* loop = drm_->GetEventLoop();
+    if (output.pacing_timer >= 0)
+      return loop->UpdateTimer(output.pacing_timer, start - now, 0);
+    Output* raw_output = &output;
+    output.pacing_timer = loop->AddTimer(
+        start - now, 0, [this, raw_output](uint64_t) {
+          DrawFrames(*raw_output);
+          // Nothing else makes the modesetter look for the frame.
+          if (!threaded_)
+            drm_->Wakeup();
+        });
+    return output.pacing_timer >= 0;
+  }
+
+  // The frame in |buffer| can be flipped now. Until then, it cost the time
+  // on the CPU, and with explicit fencing, the GPU may still be busy.
+  void DidDrawFrame(Output& output, int buffer) {
+    const Framebuffer& framebuffer = output.framebuffers[buffer];
+    uint64_t cost = NowInUsec() - framebuffer.draw_scheduled;
+    if (explicit_fencing_)
+      cost += framebuffer.gpu_usec;
+    output.pacer.AddRenderCost(cost);
+  }
+
+  void DrawFrame(Output& output, int buffer, const FrameTiming& timing) {
+    FrameStats& stats = output.stats;
+    Framebuffer& back_fb = output.framebuffers[buffer];
+    unsigned long fence_wait = 0;
+    if (back_fb.release_fence_fd >= 0) {
+      unsigned long start = NowInUsec();
+      WaitForRelease(back_fb.release_fence_fd);
+      fence_wait += NowInUsec() - start;
+      back_fb.release_fence_fd = -1;
+    }
+    CollectGPUTime(back_fb, stats);
 
     glBindFramebuffer(GL_FRAMEBUFFER, back_fb.gl_fb);
-    callback_(back_fb.gl_fb, sec * 1000000 + usec);
-    EGLSyncFence();
+    glViewport(0, 0, output.size.width, output.size.height);
+    if (egl_.timer_query_supported)
+      BeginGPUTime(back_fb);
+    BeginDamage(output, back_fb);
+    unsigned long start = NowInUsec();
+    back_fb.draw_start = start;
+    callback_(back_fb.gl_fb, timing, output.index);
+    stats.AddSample(FrameStats::CPU_DRAW, NowInUsec() - start);
+    Rect composited = ComposeOverlays(output, back_fb);
+    EndDamage(output, back_fb, composited);
+    if (back_fb.gpu_query_pending)
+      egl_.EndQueryEXT(GL_TIME_ELAPSED_EXT);
+
+    // With explicit fencing, the CPU goes on without waiting for the GPU.
+    if (explicit_fencing_)
+      back_fb.render_fence_fd = CreateRenderFence();
+    if (back_fb.render_fence_fd < 0) {
+      start = NowInUsec();
+      EGLSyncFence();
+      fence_wait += NowInUsec() - start;
+    }
+    stats.AddSample(FrameStats::FENCE_WAIT, fence_wait);
+  }
+
+  // |framebuffer| holds an older frame, so what changed since then has to be
+  // drawn again, and so does where GL drew overlays over it.
+  void BeginDamage(Output& output, Framebuffer& framebuffer) {
+    uint64_t frame = ++output.frame_count;
+    output.damage.clear();
+    output.damage_added = false;
+    if (!framebuffer.frame || frame - framebuffer.frame > kDamageHistory) {
+      output.buffer_damage = {0, 0, output.size.width, output.size.height};
+      return;
+    }
+    Rect damage = framebuffer.composited;
+    for (uint64_t i = framebuffer.frame + 1; i < frame; ++i)
+      damage = UnionRects(damage, output.damage_history[i % kDamageHistory]);
+    output.buffer_damage = damage;
+  }
+
+  // This frame differs from the last one where the client says, and where GL
+  // drew overlays over either of them.
+  void EndDamage(Output& output,
+                 Framebuffer& framebuffer,
+                 const Rect& composited) {
+    Rect screen = {0, 0, output.size.width, output.size.height};
+    Rect bounds = screen;
+    framebuffer.damage.clear();
+    if (output.damage_added) {
+      AddDamageRect(&output.damage, output.last_composited);
+      AddDamageRect(&output.damage, composited);
+      bounds = {0, 0, 0, 0};
+      for (const Rect& rect : output.damage) {
+        Rect clip = IntersectRects(rect, screen);
+        if (IsEmpty(clip))
+          continue;
+        bounds = UnionRects(bounds, clip);
+        framebuffer.damage.push_back(
+            {clip.x, clip.y, clip.width, clip.height});
+      }
+      // The display takes no clips as all of it, so send something.
+      if (framebuffer.damage.empty())
+        framebuffer.damage.push_back({0, 0, 1, 1});
+    }
+    output.damage_history[output.frame_count % kDamageHistory] = bounds;
+    output.last_composited = composited;
+    framebuffer.frame = output.frame_count;
+    framebuffer.composited = composited;
+  }
+
+  // Merges into the last rect once there are too many.
+  static void AddDamageRect(std::vector<Rect>* damage, const Rect& rect) {
+    if (IsEmpty(rect))
+      return;
+    if (damage->size() < kMaxDamageRects)
+      damage->push_back(rect);
+    else
+      damage->back() = UnionRects(damage->back(), rect);
+  }
+
+  void BeginGPUTime(Framebuffer& framebuffer) {
+    if (!framebuffer.gpu_query)
+      egl_.GenQueriesEXT(1, &framebuffer.gpu_query);
+    egl_.BeginQueryEXT(GL_TIME_ELAPSED_EXT, framebuffer.gpu_query);
+    framebuffer.gpu_query_pending = true;
+  }
+
+  // The buffer comes back only after the GPU finished the last frame in it,
+  // so the result is normally there already. Don't stall if it isn't.
+  void CollectGPUTime(Framebuffer& framebuffer, FrameStats& stats) {
+    if (!framebuffer.gpu_query_pending)
+      return;
+    framebuffer.gpu_query_pending = false;
+
+    GLuint available = 0;
+    egl_.GetQueryObjectuivEXT(framebuffer.gpu_query,
+                              GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    // A disjoint operation, e.g. a GPU clock change, spoils the result.
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (!available || disjoint)
+      return;
+
+    GLuint64 nsec = 0;
+    egl_.GetQueryObjectui64vEXT(framebuffer.gpu_query, GL_QUERY_RESULT_EXT,
+                                &nsec);
+    framebuffer.gpu_usec = nsec / 1000;
+    stats.AddSample(FrameStats::GPU_DRAW, nsec / 1000);
+  }
+
+  // Returns the overlay plane that shows |attachment| on |output|, or -1.
+  int FindOverlayPlane(size_t output, const OverlayAttachment& attachment) {
+    uint32_t fb_id = attachment.texture->AcquireScanout();
+    if (!fb_id)
+      return -1;
+    int plane = drm_->AllocateOverlayPlane(output,
+                                           attachment.texture->GetFormat(),
+                                           attachment.texture->GetModifier());
+    if (plane != -1 &&
+        !drm_->TestOverlay(output, MakeOverlay(attachment, plane, fb_id))) {
+      drm_->FreeOverlayPlane(plane);
+      plane = -1;
+    }
+    attachment.texture->ReleaseScanout(fb_id);
+    return plane;
+  }
+
+  DRMModesetter::Overlay MakeOverlay(const OverlayAttachment& attachment,
+                                     int plane,
+                                     uint32_t fb_id) {
+    StreamTexture::Dimension dimension = attachment.texture->GetDimension();
+    const Rect& dst = attachment.dst;
+    DRMModesetter::Overlay overlay;
+    overlay.plane = plane;
+    overlay.fb_id = fb_id;
+    overlay.src = {0, 0, dimension.width, dimension.height};
+    overlay.dst = {dst.x, dst.y, dst.width, dst.height};
+    overlay.zpos = attachment.zpos;
+    return overlay;
+  }
+
+  // Overlays on planes only record the framebuffer to scan out. The others
+  // are drawn over the frame, which costs the GPU a pass over |dst|.
+  // Returns the bounds of what GL drew.
+  Rect ComposeOverlays(Output& output, Framebuffer& framebuffer) {
+    // Left over if the buffer was never flipped.
+    for (const ScanoutRef& ref : framebuffer.scanout_refs)
+      ref.texture->ReleaseScanout(ref.fb_id);
+    framebuffer.scanout_refs.clear();
+    framebuffer.overlays.clear();
+
+    bool gl_state_saved = false;
+    GLState state;
+    Rect composited = {0, 0, 0, 0};
+    for (const OverlayAttachment& attachment : output.overlays) {
+      if (attachment.plane != -1) {
+        uint32_t fb_id = attachment.texture->AcquireScanout();
+        if (!fb_id)
+          continue;
+        framebuffer.overlays.push_back(
+            MakeOverlay(attachment, attachment.plane, fb_id));
+        framebuffer.scanout_refs.push_back({attachment.texture, fb_id});
+        continue;
+      }
+      bool external = attachment.texture->IsExternal();
+      GLuint& program =
+          external ? external_overlay_program_ : overlay_program_;
+      if (!program)
+        program = BuildOverlayProgram(external);
+      if (!program)
+        continue;
+      if (!gl_state_saved) {
+        SaveGLState(&state);
+        gl_state_saved = true;
+      }
+      const Rect& dst = attachment.dst;
+      // The first row of the framebuffer is the top of the display.
+      glViewport(dst.x, dst.y, dst.width, dst.height);
+      glUseProgram(program);
+      glBindTexture(external ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D,
+                    attachment.texture->GetTextureID());
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+      composited = UnionRects(composited, dst);
+    }
+    if (gl_state_saved)
+      RestoreGLState(state, output);
+    return composited;
+  }
+
+  // The client sets its GL state up once, so put back everything the
+  // composition touches.
+  struct GLState {
+    GLint program;
+    GLint array_buffer;
+    GLint active_texture;
+    GLint texture;
+    GLint external_texture;
+    GLboolean blend;
+    GLint blend_src_rgb;
+    GLint blend_dst_rgb;
+    GLint blend_src_alpha;
+    GLint blend_dst_alpha;
+    GLboolean cull_face;
+    GLboolean depth_test;
+    GLboolean scissor_test;
+    GLint attrib_enabled;
+    GLint attrib_size;
+    GLint attrib_type;
+    GLint attrib_normalized;
+    GLint attrib_stride;
+    GLint attrib_buffer;
+    void* attrib_pointer;
+  };
+
+  void SaveGLState(GLState* state) {
+    glGetIntegerv(GL_CURRENT_PROGRAM, &state->program);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &state->array_buffer);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &state->active_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &state->texture);
+    state->external_texture = 0;
+    if (egl_.external_texture_supported) {
+      glGetIntegerv(GL_TEXTURE_BINDING_EXTERNAL_OES,
+                    &state->external_texture);
+    }
+    state->blend = glIsEnabled(GL_BLEND);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &state->blend_src_rgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &state->blend_dst_rgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &state->blend_src_alpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &state->blend_dst_alpha);
+    state->cull_face = glIsEnabled(GL_CULL_FACE);
+    state->depth_test = glIsEnabled(GL_DEPTH_TEST);
+    state->scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_ENABLED,
+                        &state->attrib_enabled);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_SIZE, &state->attrib_size);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_TYPE, &state->attrib_type);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED,
+                        &state->attrib_normalized);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_STRIDE,
+                        &state->attrib_stride);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING,
+                        &state->attrib_buffer);
+    glGetVertexAttribPointerv(0, GL_VERTEX_ATTRIB_ARRAY_POINTER,
+                              &state->attrib_pointer);
+
+    // Premultiplied alpha, like the default blending of KMS planes.
+    static const GLfloat quad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, quad);
+    glEnableVertexAttribArray(0);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  void RestoreGLState(const GLState& state, const Output& output) {
+    glBindBuffer(GL_ARRAY_BUFFER, state.attrib_buffer);
+    glVertexAttribPointer(0, state.attrib_size, state.attrib_type,
+                          state.attrib_normalized, state.attrib_stride,
+                          state.attrib_pointer);
+    if (!state.attrib_enabled)
+      glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, state.array_buffer);
+    glUseProgram(state.program);
+    glBindTexture(GL_TEXTURE_2D, state.texture);
+    if (egl_.external_texture_supported)
+      glBindTexture(GL_TEXTURE_EXTERNAL_OES, state.external_texture);
+    glActiveTexture(state.active_texture);
+    if (!state.blend)
+      glDisable(GL_BLEND);
+    glBlendFuncSeparate(state.blend_src_rgb, state.blend_dst_rgb,
+                        state.blend_src_alpha, state.blend_dst_alpha);
+    if (state.cull_face)
+      glEnable(GL_CULL_FACE);
+    if (state.depth_test)
+      glEnable(GL_DEPTH_TEST);
+    if (state.scissor_test)
+      glEnable(GL_SCISSOR_TEST);
+    glViewport(0, 0, output.size.width, output.size.height);
+  }
+
+  // Returns the program drawing a texture, or an external one if |external|,
+  // or 0.
+  GLuint BuildOverlayProgram(bool external) {
+    static const char* vertex_shader_source =
+        "attribute vec2 position;\n"
+        "varying vec2 texcoord;\n"
+        "void main() {\n"
+        "  gl_Position = vec4(position, 0.0, 1.0);\n"
+        "  texcoord = position * 0.5 + 0.5;\n"
+        "}\n";
+    static const char* fragment_shader_source =
+        "precision mediump float;\n"
+        "uniform sampler2D tex;\n"
+        "varying vec2 texcoord;\n"
+        "void main() {\n"
+        "  gl_FragColor = texture2D(tex, texcoord);\n"
+        "}\n";
+    static const char* external_fragment_shader_source =
+        "#extension GL_OES_EGL_image_external : require\n"
+        "precision mediump float;\n"
+        "uniform samplerExternalOES tex;\n"
+        "varying vec2 texcoord;\n"
+        "void main() {\n"
+        "  gl_FragColor = texture2D(tex, texcoord);\n"
+        "}\n";
+
+    GLuint program = glCreateProgram();
+    GLuint shaders[] = {CompileShader(GL_VERTEX_SHADER, vertex_shader_source),
+                        CompileShader(GL_FRAGMENT_SHADER,
+                                      external
+                                          ? external_fragment_shader_source
+                                          : fragment_shader_source)};
+    for (GLuint shader : shaders) {
+      if (shader) {
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+      }
+    }
+    glBindAttribLocation(program, 0, "position");
+    glLinkProgram(program);
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!shaders[0] || !shaders[1] || !linked) {
+      fprintf(stderr, "cannot build the overlay program.\n");
+      glDeleteProgram(program);
+      return 0;
+    }
+    // The sampler is 0 by default, i.e. GL_TEXTURE0.
+    return program;
+  }
+
+  static GLuint CompileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+      glDeleteShader(shader);
+      return 0;
+    }
+    return shader;
+  }
+
+  struct RenderJob {
+    Output* output;
+    int buffer;
+    FrameTiming timing;
+  };
+
+  void RenderThreadMain() {
+    if (!eglMakeCurrent(egl_.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        egl_.context)) {
+      fprintf(stderr, "failed to make the context current on the render "
+                      "thread: %s\n",
+              EglGetError());
+      DidRenderThreadFail();
+      return;
+    }
+
+    RenderJob job;
+    while (WaitForRenderJob(&job)) {
+      DrawFrame(*job.output, job.buffer, job.timing);
+      bool pushed = ready_queue_.Push(job);
+      assert(pushed);
+      (void)pushed;
+      drm_->Wakeup();
+    }
+    if (!quit_render_thread_)
+      DidRenderThreadFail();
+
+    eglMakeCurrent(egl_.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+  }
+
+  // Blocks until the KMS thread hands over a free buffer. Returns false when
+  // the render thread has to quit.
+  bool WaitForRenderJob(RenderJob* job) {
+    while (!quit_render_thread_) {
+      if (free_queue_.Pop(job))
+        return true;
+      // eventfd keeps counting, so a wakeup between Pop() and read() is not
+      // lost.
+      uint64_t count;
+      if (read(render_wakeup_fd_, &count, sizeof(count)) < 0) {
+        fprintf(stderr, "cannot read eventfd: %m\n");
+        return false;
+      }
+    }
+    return false;
+  }
+
+  // Only the KMS thread can stop the modesetter, and it finds out in
+  // GetQueuedBuffer().
+  void DidRenderThreadFail() {
+    render_thread_failed_ = true;
+    drm_->Wakeup();
+  }
+
+  void WakeupRenderThread() {
+    uint64_t one = 1;
+    if (write(render_wakeup_fd_, &one, sizeof(one)) < 0)
+      fprintf(stderr, "cannot wake up the render thread: %m\n");
   }
 
-  uint32_t GetFrameBuffer(int front_buffer) const override {
-    return framebuffers_[front_buffer].fb_id;
+  static unsigned long NowInUsec() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ul + now.tv_nsec / 1000;
+  }
+
+  // As soon as page flip, notify the client to draw the next frame.
+  void DidPageFlip(Output& output,
+                   int front_buffer,
+                   uint64_t sequence,
+                   uint64_t nsec) {
+    output.swapchain.DidFlip();
+    assert(output.swapchain.GetScanoutBuffer() == front_buffer);
+    // The flip replaced what the overlay planes showed.
+    for (const ScanoutRef& ref : output.on_screen_scanout)
+      ref.texture->ReleaseScanout(ref.fb_id);
+    output.on_screen_scanout.swap(output.pending_scanout);
+    output.pending_scanout.clear();
+    uint64_t flip_usec = nsec / 1000;
+    output.stats.RecordFlip(flip_usec);
+    output.pacer.RecordFlip(flip_usec);
+    const Framebuffer& framebuffer = output.framebuffers[front_buffer];
+    if (framebuffer.draw_start && framebuffer.draw_start < flip_usec) {
+      output.stats.AddSample(FrameStats::LATENCY,
+                             flip_usec - framebuffer.draw_start);
+    }
+    if (framebuffer.predicted_sequence &&
+        sequence > framebuffer.predicted_sequence) {
+      output.missed_frames++;
+    }
+    output.last_flip_ns = nsec;
+    output.last_flip_sequence = sequence;
+    DrawFrames(output);
+  }
+
+  int GetQueuedBuffer(Output& output) {
+    if (threaded_) {
+      // No more frames are coming.
+      if (render_thread_failed_) {
+        drm_->Stop();
+        return -1;
+      }
+      // The buffers of every output come back in one queue.
+      RenderJob job;
+      while (ready_queue_.Pop(&job)) {
+        job.output->swapchain.QueueBuffer(job.buffer);
+        DidDrawFrame(*job.output, job.buffer);
+      }
+    }
+    return output.swapchain.BeginFlip();
+  }
+
+  // Don't wait for the page flip event to reuse the buffer on the screen; the
+  // GPU waits for |release_fence_fd| before touching it.
+  void DidCommitPageFlip(Output& output, int release_fence_fd) {
+    if (release_fence_fd < 0)
+      return;
+    int buffer = output.swapchain.ReleaseScanoutBuffer();
+    if (buffer == -1) {
+      close(release_fence_fd);
+      return;
+    }
+    output.framebuffers[buffer].release_fence_fd = release_fence_fd;
+    DrawFrames(output);
   }
 
   std::unique_ptr<ged::DRMModesetter> drm_;
@@ -483,16 +2805,58 @@ class EGLDRMGlue::Impl : public DRMModesetter::Client {
   struct gbm_device* gbm_ = nullptr;
 
   EGLGlue egl_;
-  Framebuffer framebuffers_[NUM_BUFFERS];
+  // the framebuffer formats to pick from, and the one picked
+  const std::vector<uint32_t> formats_;
+  uint32_t format_ = 0;
+  bool explicit_fencing_ = false;
+  bool detect_mapping_reads_ = false;
+  bool scanout_stream_textures_ = false;
+  bool render_late_ = false;
+  // draws the overlays that didn't get a plane
+  GLuint overlay_program_ = 0;
+  GLuint external_overlay_program_ = 0;
+  const size_t num_buffers_;
+  std::vector<std::unique_ptr<Output>> outputs_;
+
+  // For the threaded mode.
+  const bool threaded_;
+  static const size_t kMaxJobs = Swapchain::kMaxBuffers * kMaxOutputs;
+  SPSCQueue<RenderJob, kMaxJobs> free_queue_;
+  SPSCQueue<RenderJob, kMaxJobs> ready_queue_;
+  int render_wakeup_fd_ = -1;
+  std::atomic<bool> quit_render_thread_{false};
+  std::atomic<bool> render_thread_failed_{false};
 };
 
 // static
 std::unique_ptr<EGLDRMGlue> EGLDRMGlue::Create(
     std::unique_ptr<DRMModesetter> drm,
-    const SwapBuffersCallback& callback) {
+    const SwapBuffersCallback& callback,
+    size_t num_buffers,
+    bool threaded) {
+  return Create(std::move(drm), callback, num_buffers, threaded,
+                {GBM_FORMAT_XRGB8888});
+}
+
+// static
+std::unique_ptr<EGLDRMGlue> EGLDRMGlue::Create(
+    std::unique_ptr<DRMModesetter> drm,
+    const SwapBuffersCallback& callback,
+    size_t num_buffers,
+    bool threaded,
+    const std::vector<uint32_t>& formats) {
+  if (num_buffers < Swapchain::kMinBuffers ||
+      num_buffers > Swapchain::kMaxBuffers) {
+    fprintf(stderr, "the number of buffers must be between %zu and %zu.\n",
+            Swapchain::kMinBuffers, Swapchain::kMaxBuffers);
+    return nullptr;
+  }
+
   std::unique_ptr<EGLDRMGlue> egl(new EGLDRMGlue());
-  if (egl->Initialize(std::move(drm), callback))
+  if (egl->Initialize(std::move(drm), callback, num_buffers, threaded,
+                      formats)) {
     return egl;
+  }
   return nullptr;
 }
 
@@ -501,22 +2865,123 @@ EGLDRMGlue::EGLDRMGlue() {}
 EGLDRMGlue::~EGLDRMGlue() {}
 
 bool EGLDRMGlue::Initialize(std::unique_ptr<DRMModesetter> drm,
-                            const SwapBuffersCallback& callback) {
-  impl_.reset(new Impl(std::move(drm), callback));
+                            const SwapBuffersCallback& callback,
+                            size_t num_buffers,
+                            bool threaded,
+                            const std::vector<uint32_t>& formats) {
+  impl_.reset(
+      new Impl(std::move(drm), callback, num_buffers, threaded, formats));
   return impl_->Initialize();
 }
 
+size_t EGLDRMGlue::GetOutputCount() const {
+  return impl_->GetOutputCount();
+}
+
 EGLDRMGlue::Size EGLDRMGlue::GetDisplaySize() const {
-  return impl_->GetDisplaySize();
+  return impl_->GetDisplaySize(0);
+}
+
+EGLDRMGlue::Size EGLDRMGlue::GetDisplaySize(size_t output) const {
+  return impl_->GetDisplaySize(output);
+}
+
+uint32_t EGLDRMGlue::GetFormat() const {
+  return impl_->GetFormat();
+}
+
+size_t EGLDRMGlue::GetNumBuffers() const {
+  return impl_->GetNumBuffers();
+}
+
+bool EGLDRMGlue::IsThreaded() const {
+  return impl_->IsThreaded();
+}
+
+bool EGLDRMGlue::IsStreamTextureFormatSupported(uint32_t format) const {
+  return impl_->IsStreamTextureFormatSupported(format);
 }
 
 std::unique_ptr<StreamTexture> EGLDRMGlue::CreateStreamTexture(size_t width,
                                                                size_t height) {
-  return impl_->CreateStreamTexture(width, height);
+  return impl_->CreateStreamTexture(width, height, 1, GBM_FORMAT_ARGB8888);
+}
+
+std::unique_ptr<StreamTexture> EGLDRMGlue::CreateStreamTexture(
+    size_t width,
+    size_t height,
+    size_t num_slots) {
+  return impl_->CreateStreamTexture(width, height, num_slots,
+                                    GBM_FORMAT_ARGB8888);
+}
+
+std::unique_ptr<StreamTexture> EGLDRMGlue::CreateStreamTexture(
+    size_t width,
+    size_t height,
+    size_t num_slots,
+    uint32_t format) {
+  return impl_->CreateStreamTexture(width, height, num_slots, format);
+}
+
+std::unique_ptr<StreamTexture> EGLDRMGlue::ImportStreamTexture(
+    const DmaBuf& dma_buf) {
+  return impl_->ImportStreamTexture(dma_buf);
+}
+
+bool EGLDRMGlue::ImportStreamTexture(StreamTexture* texture,
+                                     const DmaBuf& dma_buf) {
+  return impl_->ImportStreamTexture(texture, dma_buf);
+}
+
+void EGLDRMGlue::SetDetectMappingReads(bool detect) {
+  impl_->SetDetectMappingReads(detect);
+}
+
+void EGLDRMGlue::SetScanoutStreamTextures(bool scanout) {
+  impl_->SetScanoutStreamTextures(scanout);
+}
+
+void EGLDRMGlue::SetRenderLate(bool render_late) {
+  impl_->SetRenderLate(render_late);
+}
+
+bool EGLDRMGlue::AttachOverlay(StreamTexture* texture,
+                               size_t output,
+                               const Rect& dst,
+                               int zpos) {
+  return impl_->AttachOverlay(texture, output, dst, zpos);
+}
+
+void EGLDRMGlue::DetachOverlay(StreamTexture* texture) {
+  impl_->DetachOverlay(texture);
+}
+
+void EGLDRMGlue::AddDamage(size_t output, const Rect& rect) {
+  impl_->AddDamage(output, rect);
+}
+
+EGLDRMGlue::Rect EGLDRMGlue::GetBufferDamage(size_t output) const {
+  return impl_->GetBufferDamage(output);
 }
 
 bool EGLDRMGlue::Run() {
   return impl_->Run();
 }
 
+void EGLDRMGlue::Stop() {
+  impl_->Stop();
+}
+
+EventLoop* EGLDRMGlue::GetEventLoop() {
+  return impl_->GetEventLoop();
+}
+
+FrameStats* EGLDRMGlue::GetFrameStats() {
+  return impl_->GetFrameStats(0);
+}
+
+FrameStats* EGLDRMGlue::GetFrameStats(size_t output) {
+  return impl_->GetFrameStats(output);
+}
+
 }  // namespace ged
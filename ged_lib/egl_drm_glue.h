@@ -24,21 +24,77 @@
 #ifndef GED_EGL_DRM_GLUE_H_
 #define GED_EGL_DRM_GLUE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace ged {
 
+class EventLoop;
+class FrameStats;
+
 class DRMModesetter;
 typedef unsigned int GLuint;
+
+// When the frame being drawn reaches the screen, as far as it can be
+// predicted. Animate to |presentation_ns|, not to the time of drawing, so
+// that the motion stays smooth when the frames ahead are slow. Times are
+// CLOCK_MONOTONIC nanoseconds, like the page flip events.
+struct FrameTiming {
+  // the VBlank that shows the frame
+  uint64_t presentation_ns = 0;
+  // its VBlank sequence number, or 0 before the first flip
+  uint64_t sequence = 0;
+  // the last page flip of the output, or 0 before the first one
+  uint64_t last_flip_ns = 0;
+  uint64_t last_flip_sequence = 0;
+  // the VBlank period, or 0 if there is none, e.g. uncapped headless
+  uint64_t refresh_ns = 0;
+  // how many frames of the output so far reached the screen later than
+  // predicted
+  uint64_t missed_frames = 0;
+};
+
 typedef std::function<void(GLuint /* gl_framebuffer */,
-                           unsigned long /* usec */)>
+                           const FrameTiming& /* timing */,
+                           size_t /* output */)>
     SwapBuffersCallback;
 
+/*
+ * StreamTexture is a texture the CPU can write into directly. The memory stays
+ * mapped for the lifetime of the texture; Map() and Unmap() only bracket the
+ * CPU access, so that the caches are kept coherent with the GPU.
+ */
 class StreamTexture {
  public:
+  enum class Access {
+    READ,
+    WRITE,
+    READ_WRITE,
+  };
+
+  // In the pixels of the plane 0.
+  struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+
   virtual ~StreamTexture() = default;
-  virtual void* Map() = 0;
+  // Returns the pixels, or nullptr. |access| is what the CPU does with them
+  // until Unmap(). The memory can be write-combined, so never read it for
+  // Access::WRITE; the pixel::Stream*() kernels write it the fastest.
+  void* Map(Access access);
+  void* Map() { return Map(Access::READ_WRITE); }
+  // The same, but only |rect| is written until Unmap(); the rest keeps the
+  // pixels of the last Unmap(). Uploads and the copies between the slots of
+  // a ring then cover only what changed.
+  virtual void* Map(Access access, const Rect& rect) = 0;
+  // Adds |rect| to what is written until Unmap().
+  virtual void MarkDirty(const Rect& rect) = 0;
   virtual void Unmap() = 0;
   virtual GLuint GetTextureID() const = 0;
   struct Dimension {
@@ -47,16 +103,54 @@ class StreamTexture {
     int stride = 0;
   };
   virtual Dimension GetDimension() const = 0;
+  // The DRM fourcc of the pixels, e.g. DRM_FORMAT_ARGB8888, which is B, G, R
+  // and A in memory.
+  virtual uint32_t GetFormat() const = 0;
+  // The bytes per pixel of the plane 0 of the DRM fourcc |format|, or 0 if
+  // stream textures don't know it.
+  static int GetBytesPerPixel(uint32_t format);
+
+  // YUV formats such as DRM_FORMAT_NV12 have a plane each for Y and for U and
+  // V. Map() returns the plane 0, and GetPlaneData() the others until
+  // Unmap(). GetDimension() is the one of the plane 0.
+  virtual size_t GetPlaneCount() const = 0;
+  virtual void* GetPlaneData(size_t plane) = 0;
+  virtual Dimension GetPlaneDimension(size_t plane) const = 0;
+  // If true, bind the texture to GL_TEXTURE_EXTERNAL_OES and sample it with
+  // samplerExternalOES, which converts YUV to RGB.
+  virtual bool IsExternal() const = 0;
 };
 
 /*
  * EGLDRMGlue provides API to handle page-flips along with VBlank interval.
+ * It renders into a swapchain of |num_buffers| framebuffers; 2 is double
+ * buffering, 3 is triple buffering, and so on up to 4.
+ * With |threaded|, Run() spawns a render thread that owns the EGL context and
+ * calls |callback|, while the calling thread only handles KMS events. In that
+ * case, don't use GL on the calling thread until Run() returns.
+ *
+ * Every display is an output with its own swapchain, and |callback| draws
+ * the frames of all of them. The viewport is already set to the size of
+ * |output| when it's called.
  */
 class EGLDRMGlue {
  public:
   static std::unique_ptr<EGLDRMGlue> Create(
       std::unique_ptr<DRMModesetter> drm,
-      const SwapBuffersCallback& callback);
+      const SwapBuffersCallback& callback,
+      size_t num_buffers,
+      bool threaded);
+  // |formats| are DRM fourcc codes in the order of preference, e.g.
+  // DRM_FORMAT_RGB565 to halve the memory traffic, or DRM_FORMAT_XRGB2101010
+  // for 10-bit panels. The framebuffers get the first one that the primary
+  // planes, GBM and EGL all support. The other Create() asks for
+  // DRM_FORMAT_XRGB8888.
+  static std::unique_ptr<EGLDRMGlue> Create(
+      std::unique_ptr<DRMModesetter> drm,
+      const SwapBuffersCallback& callback,
+      size_t num_buffers,
+      bool threaded,
+      const std::vector<uint32_t>& formats);
 
   ~EGLDRMGlue();
   EGLDRMGlue(const EGLDRMGlue&) = delete;
@@ -66,18 +160,133 @@ class EGLDRMGlue {
     int width;
     int height;
   };
+  // The versions without |output| are for the output 0.
+  size_t GetOutputCount() const;
   Size GetDisplaySize() const;
+  Size GetDisplaySize(size_t output) const;
+  // The DRM fourcc of the framebuffers.
+  uint32_t GetFormat() const;
+  // As given to Create().
+  size_t GetNumBuffers() const;
+  bool IsThreaded() const;
 
+  // True if CreateStreamTexture() can make textures of the DRM fourcc
+  // |format|. Without GBM, 10-bit formats aren't, because GLES2 can't upload
+  // them, and neither are YUV formats such as DRM_FORMAT_NV12, DRM_FORMAT_P010
+  // and DRM_FORMAT_YUV420, which also need GL_OES_EGL_image_external.
+  bool IsStreamTextureFormatSupported(uint32_t format) const;
+  // The versions without |format| make DRM_FORMAT_ARGB8888 textures.
   std::unique_ptr<StreamTexture> CreateStreamTexture(size_t width,
                                                      size_t height);
+  // A ring of |num_slots| textures, up to 8. Map() never returns the memory
+  // the GPU may still read; it waits for a fence only if every slot is busy.
+  std::unique_ptr<StreamTexture> CreateStreamTexture(size_t width,
+                                                     size_t height,
+                                                     size_t num_slots);
+  std::unique_ptr<StreamTexture> CreateStreamTexture(size_t width,
+                                                     size_t height,
+                                                     size_t num_slots,
+                                                     uint32_t format);
+  // A dma_buf that another device fills, e.g. a V4L2 camera or a video
+  // decoder. Every plane can have its own fd, or share one at different
+  // offsets.
+  struct DmaBuf {
+    // DRM_FORMAT_MOD_INVALID, which needs no libdrm header here.
+    static const uint64_t kModifierInvalid = 0x00ffffffffffffffULL;
+
+    struct Plane {
+      int fd;
+      uint32_t offset;
+      uint32_t stride;
+    };
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // a DRM fourcc
+    uint32_t format = 0;
+    // kModifierInvalid if the producer doesn't say; then the driver assumes
+    // the layout it would pick itself.
+    uint64_t modifier = kModifierInvalid;
+    std::vector<Plane> planes;
+  };
+  // Wraps |dma_buf| as a texture without a copy. The fds stay the caller's;
+  // the texture keeps its own. Map() returns nullptr, because only the GPU
+  // and the display read it. Formats that aren't RGB, e.g. DRM_FORMAT_YUYV,
+  // are external textures.
+  std::unique_ptr<StreamTexture> ImportStreamTexture(const DmaBuf& dma_buf);
+  // Makes |texture| from ImportStreamTexture() show |dma_buf| instead. A
+  // buffer that comes back, like the ones a camera cycles through, reuses
+  // its EGLImage and GL texture, so call GetTextureID() again afterwards.
+  // Don't give a buffer back to its producer until a frame showing a newer
+  // one has been flipped; the GPU or an overlay plane may still read it.
+  bool ImportStreamTexture(StreamTexture* texture, const DmaBuf& dma_buf);
+
+  // Debugging aid for the stream textures created afterwards: reports reads
+  // from the memory that Map(Access::WRITE) returns, which are very slow on
+  // write-combined mappings. See WriteOnlyGuard.
+  void SetDetectMappingReads(bool detect);
+
+  // Allocates the stream textures created afterwards in scanout memory, so
+  // that AttachOverlay() can put them on a plane. That memory is scarce on
+  // some SoCs, e.g. carved out of CMA, so only ask for the textures that
+  // may become overlays.
+  void SetScanoutStreamTextures(bool scanout);
+
+  // Starts every frame as late as it can still make its VBlank, predicted
+  // from the flips and the draw times so far, instead of as soon as a
+  // buffer is free. The frames then show newer input; FrameStats::LATENCY
+  // tells how much. A frame that takes longer than predicted misses its
+  // VBlank, though. Call it before Run().
+  void SetRenderLate(bool render_late);
+
+  typedef StreamTexture::Rect Rect;
+  // Shows |texture| scaled into |dst| of |output|, over what |callback|
+  // draws, in the order of |zpos|. If an overlay plane can scan the texture
+  // out, the display controller blends it and the GPU never touches it;
+  // returns true then. Otherwise the texture is drawn with GL after
+  // |callback|, below the textures on planes. Either way the alpha is
+  // premultiplied.
+  // On a plane, a texture must not be written while it's on the screen; a
+  // ring of 3 or more slots never is. |texture| must come from
+  // CreateStreamTexture() or ImportStreamTexture() and outlive Run(); only
+  // the ones created after SetScanoutStreamTextures(true) or imported can
+  // go on a plane. Call it before Run(), or from |callback| without
+  // |threaded|.
+  bool AttachOverlay(StreamTexture* texture,
+                     size_t output,
+                     const Rect& dst,
+                     int zpos);
+  void DetachOverlay(StreamTexture* texture);
+
+  // Call from |callback| with each part of the frame of |output| that
+  // differs from the last one, in the coordinates of glViewport(). Without
+  // a call, all of it does. With atomic modesetting, the display gets them
+  // as FB_DAMAGE_CLIPS, so a panel with self refresh fetches only those.
+  void AddDamage(size_t output, const Rect& rect);
+  // What |callback| has to draw besides what it passes to AddDamage(). The
+  // framebuffers take turns, so the one being drawn is a few frames old;
+  // this is what changed since then, or all of it if it's never been drawn.
+  Rect GetBufferDamage(size_t output) const;
 
   bool Run();
+  // Makes Run() return after the pending page flip. Call it on the thread
+  // running Run(), e.g. from a callback registered to GetEventLoop().
+  void Stop();
+
+  // The loop that Run() dispatches KMS events on.
+  EventLoop* GetEventLoop();
+
+  // Timings of every frame drawn and flipped so far.
+  FrameStats* GetFrameStats();
+  FrameStats* GetFrameStats(size_t output);
 
  private:
   EGLDRMGlue();
 
   bool Initialize(std::unique_ptr<DRMModesetter> drm,
-                  const SwapBuffersCallback& callback);
+                  const SwapBuffersCallback& callback,
+                  size_t num_buffers,
+                  bool threaded,
+                  const std::vector<uint32_t>& formats);
 
   class Impl;
   std::unique_ptr<Impl> impl_;
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "event_loop.h"
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+
+namespace ged {
+
+class EventLoop::Impl {
+ public:
+  Impl() {}
+  Impl(const Impl&) = delete;
+  void operator=(const Impl&) = delete;
+
+  ~Impl() {
+    for (auto& source : sources_) {
+      if (source.second->owns_fd)
+        close(source.second->fd);
+    }
+    if (quit_fd_ >= 0)
+      close(quit_fd_);
+    if (epoll_fd_ >= 0)
+      close(epoll_fd_);
+  }
+
+  bool Initialize() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+      fprintf(stderr, "cannot create epoll: %m\n");
+      return false;
+    }
+
+    quit_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (quit_fd_ < 0) {
+      fprintf(stderr, "cannot create eventfd: %m\n");
+      return false;
+    }
+    return AddFD(quit_fd_, EPOLLIN, [this](uint32_t) {
+      uint64_t count;
+      if (read(quit_fd_, &count, sizeof(count)) < 0)
+        fprintf(stderr, "cannot read eventfd: %m\n");
+    });
+  }
+
+  bool AddFD(int fd, uint32_t events, const FDCallback& callback) {
+    std::shared_ptr<Source> source(new Source());
+    source->on_fd = callback;
+    return AddSource(fd, events, source);
+  }
+
+  int AddTimer(uint64_t delay_usec,
+               uint64_t interval_usec,
+               const TimerCallback& callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) {
+      fprintf(stderr, "cannot create timerfd: %m\n");
+      return -1;
+    }
+
+    std::shared_ptr<Source> source(new Source());
+    source->owns_fd = true;
+    source->on_fd = [fd, callback](uint32_t) {
+      uint64_t expirations = 0;
+      if (read(fd, &expirations, sizeof(expirations)) < 0)
+        return;
+      callback(expirations);
+    };
+    if (!UpdateTimer(fd, delay_usec, interval_usec) ||
+        !AddSource(fd, EPOLLIN, source)) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  bool UpdateTimer(int timer_fd, uint64_t delay_usec, uint64_t interval_usec) {
+    itimerspec spec = {};
+    // A zero it_value disarms the timer, so fire as soon as possible instead.
+    if (!delay_usec)
+      delay_usec = 1;
+    spec.it_value.tv_sec = delay_usec / 1000000;
+    spec.it_value.tv_nsec = (delay_usec % 1000000) * 1000;
+    spec.it_interval.tv_sec = interval_usec / 1000000;
+    spec.it_interval.tv_nsec = (interval_usec % 1000000) * 1000;
+    if (timerfd_settime(timer_fd, 0, &spec, nullptr)) {
+      fprintf(stderr, "cannot arm timerfd: %m\n");
+      return false;
+    }
+    return true;
+  }
+
+  int AddSignal(int signo, const SignalCallback& callback) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    if (pthread_sigmask(SIG_BLOCK, &mask, nullptr)) {
+      fprintf(stderr, "cannot block signal %d\n", signo);
+      return -1;
+    }
+
+    int fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (fd < 0) {
+      fprintf(stderr, "cannot create signalfd: %m\n");
+      return -1;
+    }
+
+    std::shared_ptr<Source> source(new Source());
+    source->owns_fd = true;
+    source->on_fd = [fd, callback](uint32_t) {
+      signalfd_siginfo info;
+      while (read(fd, &info, sizeof(info)) == sizeof(info))
+        callback(info.ssi_signo);
+    };
+    if (!AddSource(fd, EPOLLIN, source)) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  void Remove(int fd) {
+    auto id = ids_.find(fd);
+    if (id == ids_.end())
+      return;
+    auto it = sources_.find(id->second);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (it->second->owns_fd)
+      close(fd);
+    sources_.erase(it);
+    ids_.erase(id);
+  }
+
+  bool Run() {
+    static const int kMaxEvents = 16;
+    epoll_event events[kMaxEvents];
+
+    while (!quit_) {
+      int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+      if (count < 0) {
+        if (errno == EINTR)
+          continue;
+        fprintf(stderr, "epoll_wait err: %m\n");
+        return false;
+      }
+
+      for (int i = 0; i < count && !quit_; ++i) {
+        // Look the source up again, because an earlier callback could have
+        // removed it, and even added another one on the same fd number, so
+        // go by the id rather than the fd. Holding a reference keeps the
+        // callback alive even if it removes itself.
+        auto it = sources_.find(events[i].data.u64);
+        if (it == sources_.end())
+          continue;
+        std::shared_ptr<Source> source = it->second;
+        source->on_fd(events[i].events);
+      }
+    }
+    quit_ = false;
+    return true;
+  }
+
+  void Quit() {
+    quit_ = true;
+    uint64_t one = 1;
+    if (write(quit_fd_, &one, sizeof(one)) < 0)
+      fprintf(stderr, "cannot wake up the event loop: %m\n");
+  }
+
+ private:
+  struct Source {
+    int fd = -1;
+    // Unique for the life of the loop, unlike fd numbers.
+    uint64_t id = 0;
+    FDCallback on_fd;
+    // timerfd and signalfd are made by us.
+    bool owns_fd = false;
+  };
+
+  bool AddSource(int fd, uint32_t events, std::shared_ptr<Source> source) {
+    source->fd = fd;
+    source->id = next_id_;
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = source->id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)) {
+      fprintf(stderr, "cannot watch fd %d: %m\n", fd);
+      return false;
+    }
+    next_id_++;
+    sources_[source->id] = source;
+    ids_[fd] = source->id;
+    return true;
+  }
+
+  int epoll_fd_ = -1;
+  int quit_fd_ = -1;
+  std::atomic<bool> quit_{false};
+  uint64_t next_id_ = 0;
+  std::map<uint64_t, std::shared_ptr<Source>> sources_;
+  // Only for Remove(); events are dispatched by the id.
+  std::map<int, uint64_t> ids_;
+};
+
+// static
+std::unique_ptr<EventLoop> EventLoop::Create() {
+  std::unique_ptr<EventLoop> loop(new EventLoop());
+  if (loop->Initialize())
+    return loop;
+  return nullptr;
+}
+
+EventLoop::EventLoop() {}
+
+EventLoop::~EventLoop() {}
+
+bool EventLoop::Initialize() {
+  impl_.reset(new Impl());
+  return impl_->Initialize();
+}
+
+bool EventLoop::AddFD(int fd, uint32_t events, const FDCallback& callback) {
+  return impl_->AddFD(fd, events, callback);
+}
+
+int EventLoop::AddTimer(uint64_t delay_usec,
+                        uint64_t interval_usec,
+                        const TimerCallback& callback) {
+  return impl_->AddTimer(delay_usec, interval_usec, callback);
+}
+
+bool EventLoop::UpdateTimer(int timer_fd,
+                            uint64_t delay_usec,
+                            uint64_t interval_usec) {
+  return impl_->UpdateTimer(timer_fd, delay_usec, interval_usec);
+}
+
+int EventLoop::AddSignal(int signo, const SignalCallback& callback) {
+  return impl_->AddSignal(signo, callback);
+}
+
+void EventLoop::Remove(int fd) {
+  impl_->Remove(fd);
+}
+
+bool EventLoop::Run() {
+  return impl_->Run();
+}
+
+void EventLoop::Quit() {
+  impl_->Quit();
+}
+
+}  // namespace ged
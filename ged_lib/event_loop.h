@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_EVENT_LOOP_H_
+#define GED_EVENT_LOOP_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace ged {
+
+/*
+ * EventLoop is an epoll based loop that dispatches fd readiness, timers
+ * (timerfd) and signals (signalfd) on one thread. DRMModesetter runs its page
+ * flip handling on it, so clients can service their own sockets, input
+ * devices and so on without another thread.
+ *
+ * Every source is identified by a fd: the one given to AddFD(), or the
+ * timerfd/signalfd returned by AddTimer()/AddSignal(). Sources can be added or
+ * removed from inside callbacks.
+ */
+class EventLoop {
+ public:
+  // |events| is the epoll event mask that fired.
+  typedef std::function<void(uint32_t events)> FDCallback;
+  // |expirations| is how many times the timer expired since the last call.
+  typedef std::function<void(uint64_t expirations)> TimerCallback;
+  typedef std::function<void(int signo)> SignalCallback;
+
+  static std::unique_ptr<EventLoop> Create();
+
+  ~EventLoop();
+  EventLoop(const EventLoop&) = delete;
+  void operator=(const EventLoop&) = delete;
+
+  // Watches |fd| for the epoll |events|, e.g. EPOLLIN. The caller keeps the
+  // ownership of |fd|.
+  bool AddFD(int fd, uint32_t events, const FDCallback& callback);
+
+  // Calls |callback| after |delay_usec|, and then every |interval_usec| unless
+  // it's 0. Returns the timerfd, or -1.
+  int AddTimer(uint64_t delay_usec,
+               uint64_t interval_usec,
+               const TimerCallback& callback);
+  // Re-arms a timer made by AddTimer().
+  bool UpdateTimer(int timer_fd, uint64_t delay_usec, uint64_t interval_usec);
+
+  // Blocks |signo| for the calling thread and delivers it through the loop
+  // instead. Call it before spawning threads, so that they inherit the mask.
+  // Returns the signalfd, or -1.
+  int AddSignal(int signo, const SignalCallback& callback);
+
+  // Stops watching |fd|. Timer and signal fds are closed.
+  void Remove(int fd);
+
+  // Dispatches events until Quit().
+  bool Run();
+
+  // Thread-safe.
+  void Quit();
+
+ private:
+  EventLoop();
+
+  bool Initialize();
+
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ged
+
+#endif  // GED_EVENT_LOOP_H_
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ged {
+namespace {
+
+// A flip interval further off than that from a whole number of periods is a
+// late timestamp, not a period to learn from.
+const double kMaxPeriodError = 1 / 16.;
+// How fast the period follows the measured one.
+const double kPeriodWeight = 1 / 8.;
+
+}  // namespace
+
+FramePacer::FramePacer(uint64_t margin_usec) : margin_(margin_usec) {}
+
+FramePacer::~FramePacer() {}
+
+void FramePacer::SetRefreshInterval(uint64_t usec) {
+  nominal_period_ = usec;
+  period_ = usec;
+}
+
+void FramePacer::RecordFlip(uint64_t usec) {
+  uint64_t last_vblank = last_vblank_;
+  last_vblank_ = usec;
+  if (!nominal_period_ || !last_vblank || usec <= last_vblank)
+    return;
+  // Missed VBlanks make the interval a multiple of the period.
+  double interval = usec - last_vblank;
+  double vblanks = std::max(1., std::round(interval / period_));
+  double period = interval / vblanks;
+  if (std::abs(period - nominal_period_) > nominal_period_ * kMaxPeriodError)
+    return;
+  period_ += (period - period_) * kPeriodWeight;
+}
+
+void FramePacer::AddRenderCost(uint64_t usec) {
+  costs_[cost_count_++ % kCostWindow] = usec;
+}
+
+uint64_t FramePacer::GetRefreshInterval() const {
+  return period_ + 0.5;
+}
+
+uint64_t FramePacer::GetNextVBlank(uint64_t now) const {
+  if (!period_ || !last_vblank_)
+    return 0;
+  if (now < last_vblank_)
+    return last_vblank_;
+  uint64_t vblanks = (now - last_vblank_) / period_ + 1;
+  return last_vblank_ + uint64_t(vblanks * period_ + 0.5);
+}
+
+uint64_t FramePacer::GetPredictedCost() const {
+  size_t count = cost_count_ < kCostWindow ? cost_count_ : kCostWindow;
+  return count ? *std::max_element(costs_, costs_ + count) : 0;
+}
+
+uint64_t FramePacer::GetRenderStart(uint64_t now, size_t frames_ahead) const {
+  uint64_t target = GetTargetVBlank(now, frames_ahead);
+  uint64_t lead = GetPredictedCost() + margin_;
+  // Too late for it anyway; the frame goes out a VBlank later.
+  if (!target || target < now + lead)
+    return now;
+  return target - lead;
+}
+
+uint64_t FramePacer::GetPresentationTime(uint64_t now,
+                                         size_t frames_ahead) const {
+  uint64_t target = GetTargetVBlank(now, frames_ahead);
+  if (!target)
+    return 0;
+  // A frame that isn't ready by then takes the first VBlank after it is.
+  return std::max(target, GetNextVBlank(now + GetPredictedCost()));
+}
+
+uint64_t FramePacer::GetTargetVBlank(uint64_t now, size_t frames_ahead) const {
+  uint64_t next_vblank = GetNextVBlank(now);
+  if (!next_vblank)
+    return 0;
+  return next_vblank + uint64_t(frames_ahead * period_ + 0.5);
+}
+
+}  // namespace ged
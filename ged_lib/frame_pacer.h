@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_FRAME_PACER_H_
+#define GED_FRAME_PACER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ged {
+
+/*
+ * FramePacer predicts when to start drawing a frame so that it's done just
+ * before the VBlank that shows it, instead of right after the flip that
+ * freed its buffer. The frame then shows input that is up to a refresh
+ * period newer.
+ *
+ * The VBlank phase comes from the page flip timestamps, which also refine
+ * the nominal period of the mode. The render cost is the longest of the
+ * recent frames, and |margin_usec| covers the rest of the jitter. All times
+ * are CLOCK_MONOTONIC microseconds. Not thread-safe.
+ */
+class FramePacer {
+ public:
+  static const uint64_t kDefaultMarginUsec = 2000;
+
+  explicit FramePacer(uint64_t margin_usec = kDefaultMarginUsec);
+  ~FramePacer();
+  FramePacer(const FramePacer&) = delete;
+  void operator=(const FramePacer&) = delete;
+
+  // The VBlank period of the mode. While it's 0, frames start right away.
+  void SetRefreshInterval(uint64_t usec);
+  // A page flip, i.e. a VBlank, happened at |usec|.
+  void RecordFlip(uint64_t usec);
+  // A frame took |usec| from the start of drawing until it could be flipped.
+  void AddRenderCost(uint64_t usec);
+
+  // The learned VBlank period, or 0.
+  uint64_t GetRefreshInterval() const;
+  // The first VBlank after |now|, or 0 before the first flip.
+  uint64_t GetNextVBlank(uint64_t now) const;
+  uint64_t GetPredictedCost() const;
+  // When to start a frame that comes after |frames_ahead| others, so that
+  // it makes the VBlank right after theirs. Never earlier than |now|.
+  uint64_t GetRenderStart(uint64_t now, size_t frames_ahead) const;
+  // The VBlank that shows a frame started at |now| after |frames_ahead|
+  // others, or 0 before the first flip.
+  uint64_t GetPresentationTime(uint64_t now, size_t frames_ahead) const;
+
+ private:
+  static const size_t kCostWindow = 32;
+
+  // The VBlank right after the ones of the frames ahead, or 0.
+  uint64_t GetTargetVBlank(uint64_t now, size_t frames_ahead) const;
+
+  const uint64_t margin_;
+  uint64_t nominal_period_ = 0;
+  // fractional, so that the rounding doesn't add up over many periods
+  double period_ = 0;
+  uint64_t last_vblank_ = 0;
+  uint64_t costs_[kCostWindow] = {};
+  size_t cost_count_ = 0;
+};
+
+}  // namespace ged
+
+#endif  // GED_FRAME_PACER_H_
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_stats.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace ged {
+namespace {
+
+/*
+ * Values below kSubBuckets get their own bucket. Above that, every power of
+ * two range is split into kSubBuckets buckets, so the bucket width is at most
+ * 1/16 of the value.
+ */
+const int kSubBucketBits = 4;
+const uint64_t kSubBuckets = 1 << kSubBucketBits;
+// Up to 2^32 usec, i.e. more than an hour.
+const size_t kNumBuckets = (32 - kSubBucketBits + 1) * kSubBuckets;
+
+size_t GetBucketIndex(uint64_t value) {
+  if (value < kSubBuckets)
+    return value;
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - kSubBucketBits;
+  size_t index = (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+  return index < kNumBuckets ? index : kNumBuckets - 1;
+}
+
+// Returns the middle of the bucket.
+uint64_t GetBucketValue(size_t index) {
+  if (index < kSubBuckets)
+    return index;
+  int shift = index / kSubBuckets - 1;
+  uint64_t low = (kSubBuckets + index % kSubBuckets) << shift;
+  return low + ((1ull << shift) >> 1);
+}
+
+}  // namespace
+
+FrameStats::FrameStats() {
+  Reset();
+}
+
+FrameStats::~FrameStats() {}
+
+// static
+const char* FrameStats::GetMetricName(Metric metric) {
+  switch (metric) {
+    case CPU_DRAW:
+      return "cpu_draw";
+    case GPU_DRAW:
+      return "gpu_draw";
+    case FENCE_WAIT:
+      return "fence_wait";
+    case FLIP_INTERVAL:
+      return "flip_interval";
+    case LATENCY:
+      return "latency";
+    default:
+      return "???";
+  }
+}
+
+void FrameStats::SetRefreshInterval(uint64_t usec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refresh_interval_ = usec;
+}
+
+void FrameStats::AddSample(Metric metric, uint64_t usec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Histogram& histogram = histograms_[metric];
+  histogram.buckets[GetBucketIndex(usec)]++;
+  if (!histogram.count || usec < histogram.min)
+    histogram.min = usec;
+  if (usec > histogram.max)
+    histogram.max = usec;
+  histogram.count++;
+  histogram.sum += usec;
+}
+
+void FrameStats::RecordFlip(uint64_t usec) {
+  uint64_t interval = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t last_flip = last_flip_;
+    last_flip_ = usec;
+    flip_count_++;
+    if (!last_flip || usec < last_flip)
+      return;
+    interval = usec - last_flip;
+    if (refresh_interval_) {
+      uint64_t vblanks =
+          (interval + refresh_interval_ / 2) / refresh_interval_;
+      if (vblanks > 1)
+        missed_vblanks_ += vblanks - 1;
+    }
+  }
+  AddSample(FLIP_INTERVAL, interval);
+}
+
+FrameStats::Summary FrameStats::GetSummary(Metric metric) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetSummaryLocked(metric);
+}
+
+uint64_t FrameStats::GetFlipCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return flip_count_;
+}
+
+uint64_t FrameStats::GetMissedVBlanks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return missed_vblanks_;
+}
+
+std::string FrameStats::ToString() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string result;
+  char buf[128];
+  Summary flip = GetSummaryLocked(FLIP_INTERVAL);
+  snprintf(buf, sizeof(buf),
+           "FPS: %.2f, flips: %" PRIu64 ", missed vblanks: %" PRIu64,
+           flip.mean ? 1000000.0 / flip.mean : 0.0, flip_count_,
+           missed_vblanks_);
+  result += buf;
+  for (int i = 0; i < NUM_METRICS; ++i) {
+    Metric metric = static_cast<Metric>(i);
+    Summary summary = GetSummaryLocked(metric);
+    if (!summary.count)
+      continue;
+    snprintf(buf, sizeof(buf),
+             ", %s p50/p99: %" PRIu64 "/%" PRIu64 " us",
+             GetMetricName(metric), summary.p50, summary.p99);
+    result += buf;
+  }
+  return result;
+}
+
+std::string FrameStats::ToJSON() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string result;
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"refresh_interval_us\": %" PRIu64 ", \"flips\": %" PRIu64
+           ", \"missed_vblanks\": %" PRIu64,
+           refresh_interval_, flip_count_, missed_vblanks_);
+  result += buf;
+  for (int i = 0; i < NUM_METRICS; ++i) {
+    Metric metric = static_cast<Metric>(i);
+    Summary summary = GetSummaryLocked(metric);
+    snprintf(buf, sizeof(buf),
+             ", \"%s\": {\"count\": %" PRIu64 ", \"min_us\": %" PRIu64
+             ", \"max_us\": %" PRIu64 ", \"mean_us\": %" PRIu64
+             ", \"p50_us\": %" PRIu64 ", \"p95_us\": %" PRIu64
+             ", \"p99_us\": %" PRIu64 "}",
+             GetMetricName(metric), summary.count, summary.min, summary.max,
+             summary.mean, summary.p50, summary.p95, summary.p99);
+    result += buf;
+  }
+  result += "}";
+  return result;
+}
+
+void FrameStats::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& histogram : histograms_) {
+    histogram = Histogram();
+    histogram.buckets.resize(kNumBuckets);
+  }
+  last_flip_ = 0;
+  flip_count_ = 0;
+  missed_vblanks_ = 0;
+}
+
+FrameStats::Summary FrameStats::GetSummaryLocked(Metric metric) const {
+  const Histogram& histogram = histograms_[metric];
+  Summary summary;
+  if (!histogram.count)
+    return summary;
+
+  summary.count = histogram.count;
+  summary.min = histogram.min;
+  summary.max = histogram.max;
+  summary.mean = histogram.sum / histogram.count;
+
+  struct {
+    double fraction;
+    uint64_t* value;
+  } percentiles[] = {
+      {0.50, &summary.p50}, {0.95, &summary.p95}, {0.99, &summary.p99},
+  };
+  uint64_t seen = 0;
+  size_t next = 0;
+  for (size_t i = 0; i < kNumBuckets && next < 3; ++i) {
+    seen += histogram.buckets[i];
+    while (next < 3 && seen >= percentiles[next].fraction * histogram.count) {
+      // The bucket middle can fall outside of the real range.
+      uint64_t value = GetBucketValue(i);
+      if (value < histogram.min)
+        value = histogram.min;
+      if (value > histogram.max)
+        value = histogram.max;
+      *percentiles[next].value = value;
+      next++;
+    }
+  }
+  return summary;
+}
+
+}  // namespace ged
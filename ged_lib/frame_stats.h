@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_FRAME_STATS_H_
+#define GED_FRAME_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ged {
+
+/*
+ * FrameStats collects per-frame timings, so that a regression can be traced
+ * to the CPU, the GPU or the scanout. Every metric is kept in a log-linear
+ * histogram in microseconds, which is precise to about 6%.
+ *
+ * EGLDRMGlue records into it from both the KMS thread and the render thread,
+ * so every method is thread-safe.
+ */
+class FrameStats {
+ public:
+  enum Metric {
+    // the client's draw callback on the CPU
+    CPU_DRAW,
+    // the GPU time of the frame, only with GL_EXT_disjoint_timer_query
+    GPU_DRAW,
+    // the CPU blocked on render or release fences
+    FENCE_WAIT,
+    // between two consecutive page flip events
+    FLIP_INTERVAL,
+    // from the start of the draw callback to the flip showing the frame,
+    // i.e. how old the input the frame shows is when it reaches the screen
+    LATENCY,
+    NUM_METRICS,
+  };
+
+  struct Summary {
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    uint64_t mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p95 = 0;
+    uint64_t p99 = 0;
+  };
+
+  FrameStats();
+  ~FrameStats();
+  FrameStats(const FrameStats&) = delete;
+  void operator=(const FrameStats&) = delete;
+
+  static const char* GetMetricName(Metric metric);
+
+  // The VBlank period of the display. 0 disables missed VBlank counting.
+  void SetRefreshInterval(uint64_t usec);
+
+  void AddSample(Metric metric, uint64_t usec);
+
+  // Records a page flip event at |usec|. A flip-to-flip interval spanning N
+  // VBlanks counts as N - 1 missed VBlanks.
+  void RecordFlip(uint64_t usec);
+
+  Summary GetSummary(Metric metric) const;
+  uint64_t GetFlipCount() const;
+  uint64_t GetMissedVBlanks() const;
+
+  // One line for humans, with the average FPS.
+  std::string ToString() const;
+  // Everything as a JSON object, for scripts.
+  std::string ToJSON() const;
+
+  void Reset();
+
+ private:
+  struct Histogram {
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    uint64_t sum = 0;
+  };
+
+  Summary GetSummaryLocked(Metric metric) const;
+
+  mutable std::mutex mutex_;
+  Histogram histograms_[NUM_METRICS];
+  uint64_t refresh_interval_ = 0;
+  uint64_t last_flip_ = 0;
+  uint64_t flip_count_ = 0;
+  uint64_t missed_vblanks_ = 0;
+};
+
+}  // namespace ged
+
+#endif  // GED_FRAME_STATS_H_
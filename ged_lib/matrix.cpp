@@ -43,14 +43,166 @@
 #include <cmath>
 #include <cstring>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace ged {
 
+namespace {
+
+// One row of a matrix, i.e. one SIMD register. Every operation below is a
+// row times a scalar, so the products are summed in the same order as the
+// plain C++ code, and all builds give the same results.
+#if defined(__SSE__)
+
+typedef __m128 Row;
+
+inline Row LoadRow(const float* row) {
+  return _mm_load_ps(row);
+}
+
+inline void StoreRow(float* row, Row value) {
+  _mm_store_ps(row, value);
+}
+
+inline Row MulRow(Row row, float s) {
+  return _mm_mul_ps(row, _mm_set1_ps(s));
+}
+
+inline Row MulAddRow(Row sum, Row row, float s) {
+  return _mm_add_ps(sum, _mm_mul_ps(row, _mm_set1_ps(s)));
+}
+
+inline Row AddRow(Row a, Row b) {
+  return _mm_add_ps(a, b);
+}
+
+#elif defined(__ARM_NEON)
+
+typedef float32x4_t Row;
+
+inline Row LoadRow(const float* row) {
+  return vld1q_f32(row);
+}
+
+inline void StoreRow(float* row, Row value) {
+  vst1q_f32(row, value);
+}
+
+inline Row MulRow(Row row, float s) {
+  return vmulq_n_f32(row, s);
+}
+
+inline Row MulAddRow(Row sum, Row row, float s) {
+  return vmlaq_n_f32(sum, row, s);
+}
+
+inline Row AddRow(Row a, Row b) {
+  return vaddq_f32(a, b);
+}
+
+#else
+
+struct Row {
+  float v[4];
+};
+
+inline Row LoadRow(const float* row) {
+  return {{row[0], row[1], row[2], row[3]}};
+}
+
+inline void StoreRow(float* row, Row value) {
+  std::copy(value.v, value.v + 4, row);
+}
+
+inline Row MulRow(Row row, float s) {
+  return {{row.v[0] * s, row.v[1] * s, row.v[2] * s, row.v[3] * s}};
+}
+
+inline Row MulAddRow(Row sum, Row row, float s) {
+  return {{sum.v[0] + row.v[0] * s, sum.v[1] + row.v[1] * s,
+           sum.v[2] + row.v[2] * s, sum.v[3] + row.v[3] * s}};
+}
+
+inline Row AddRow(Row a, Row b) {
+  return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+
+#endif
+
+// c[0] * r0 + c[1] * r1 + c[2] * r2
+inline Row Combine3(const float* c, Row r0, Row r1, Row r2) {
+  Row sum = MulRow(r0, c[0]);
+  sum = MulAddRow(sum, r1, c[1]);
+  return MulAddRow(sum, r2, c[2]);
+}
+
+// c[0] * r0 + c[1] * r1 + c[2] * r2 + c[3] * r3
+inline Row Combine(const float* c, Row r0, Row r1, Row r2, Row r3) {
+  return MulAddRow(Combine3(c, r0, r1, r2), r3, c[3]);
+}
+
+// Both at once, in float instead of the double that M_PI promotes to.
+inline void SinCos(float degrees, float* sin_angle, float* cos_angle) {
+  const float kRadiansPerDegree = static_cast<float>(M_PI / 180.0);
+  sincosf(degrees * kRadiansPerDegree, sin_angle, cos_angle);
+}
+
+// out = a * b. |out| can be |a| or |b|.
+inline void Multiply(const float (*a)[4],
+                     const float (*b)[4],
+                     float (*out)[4]) {
+  Row b0 = LoadRow(b[0]);
+  Row b1 = LoadRow(b[1]);
+  Row b2 = LoadRow(b[2]);
+  Row b3 = LoadRow(b[3]);
+  // Row i of |a| is read before row i of |out| is written.
+  for (int i = 0; i < 4; i++)
+    StoreRow(out[i], Combine(a[i], b0, b1, b2, b3));
+}
+
+}  // namespace
+
 Matrix::Matrix() {
   InitIdentity();
 }
 
 Matrix::~Matrix() {}
 
+// static
+Matrix Matrix::FromTRS(const Vector3& translation,
+                       const Vector3& degrees,
+                       const Vector3& scale) {
+  float sx, cx, sy, cy, sz, cz;
+  SinCos(degrees.x, &sx, &cx);
+  SinCos(degrees.y, &sy, &cy);
+  SinCos(degrees.z, &sz, &cz);
+
+  // rotation z * rotation y * rotation x, multiplied out.
+  Matrix m;
+  m.m_[0][0] = cz * cy * scale.x;
+  m.m_[0][1] = (cz * sy * sx - sz * cx) * scale.x;
+  m.m_[0][2] = (cz * sy * cx + sz * sx) * scale.x;
+  m.m_[1][0] = sz * cy * scale.y;
+  m.m_[1][1] = (sz * sy * sx + cz * cx) * scale.y;
+  m.m_[1][2] = (sz * sy * cx - cz * sx) * scale.y;
+  m.m_[2][0] = -sy * scale.z;
+  m.m_[2][1] = cy * sx * scale.z;
+  m.m_[2][2] = cy * cx * scale.z;
+  m.m_[3][0] = translation.x;
+  m.m_[3][1] = translation.y;
+  m.m_[3][2] = translation.z;
+  return m;
+}
+
+// static
+Matrix Matrix::FromEuler(const Vector3& degrees) {
+  return FromTRS({0.f, 0.f, 0.f}, degrees, {1.f, 1.f, 1.f});
+}
+
 void Matrix::operator=(const Matrix& other) {
   std::copy(&other.m_[0][0], &other.m_[3][3] + 1, &m_[0][0]);
 }
@@ -71,6 +223,32 @@ void Matrix::Get3x3(float* m3x3) const {
   m3x3[8] = m_[2][2];
 }
 
+bool Matrix::GetNormalMatrix(float* m3x3) const {
+  // The cofactors over the determinant. Row i of the cofactor matrix is the
+  // cross product of the other two rows.
+  float cofactor[3][3];
+  for (int i = 0; i < 3; i++) {
+    const float* a = m_[(i + 1) % 3];
+    const float* b = m_[(i + 2) % 3];
+    cofactor[i][0] = a[1] * b[2] - a[2] * b[1];
+    cofactor[i][1] = a[2] * b[0] - a[0] * b[2];
+    cofactor[i][2] = a[0] * b[1] - a[1] * b[0];
+  }
+  float det = m_[0][0] * cofactor[0][0] + m_[0][1] * cofactor[0][1] +
+              m_[0][2] * cofactor[0][2];
+  if (std::fabs(det) < 1e-12f) {
+    Get3x3(m3x3);
+    return false;
+  }
+
+  float inv_det = 1.0f / det;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++)
+      m3x3[i * 3 + j] = cofactor[i][j] * inv_det;
+  }
+  return true;
+}
+
 void Matrix::InitIdentity() {
   std::memset(m_, 0, sizeof m_);
   m_[0][0] = 1.0f;
@@ -80,52 +258,67 @@ void Matrix::InitIdentity() {
 }
 
 void Matrix::MatrixMultiply(const Matrix& op) {
-  Matrix tmp;
-  for (int i = 0; i < 4; i++) {
-    tmp.m_[i][0] = (m_[i][0] * op.m_[0][0]) + (m_[i][1] * op.m_[1][0]) +
-                   (m_[i][2] * op.m_[2][0]) + (m_[i][3] * op.m_[3][0]);
+  Multiply(m_, op.m_, m_);
+}
 
-    tmp.m_[i][1] = (m_[i][0] * op.m_[0][1]) + (m_[i][1] * op.m_[1][1]) +
-                   (m_[i][2] * op.m_[2][1]) + (m_[i][3] * op.m_[3][1]);
+// static
+void Matrix::MultiplyArray(const Matrix* a,
+                           const Matrix* b,
+                           Matrix* out,
+                           size_t count) {
+  for (size_t i = 0; i < count; i++)
+    Multiply(a[i].m_, b[i].m_, out[i].m_);
+}
 
-    tmp.m_[i][2] = (m_[i][0] * op.m_[0][2]) + (m_[i][1] * op.m_[1][2]) +
-                   (m_[i][2] * op.m_[2][2]) + (m_[i][3] * op.m_[3][2]);
+// static
+void Matrix::MultiplyArray(const Matrix* a,
+                           const Matrix& b,
+                           Matrix* out,
+                           size_t count) {
+  // |b| stays in registers for the whole array.
+  Row b0 = LoadRow(b.m_[0]);
+  Row b1 = LoadRow(b.m_[1]);
+  Row b2 = LoadRow(b.m_[2]);
+  Row b3 = LoadRow(b.m_[3]);
+  for (size_t i = 0; i < count; i++) {
+    for (int j = 0; j < 4; j++)
+      StoreRow(out[i].m_[j], Combine(a[i].m_[j], b0, b1, b2, b3));
+  }
+}
 
-    tmp.m_[i][3] = (m_[i][0] * op.m_[0][3]) + (m_[i][1] * op.m_[1][3]) +
-                   (m_[i][2] * op.m_[2][3]) + (m_[i][3] * op.m_[3][3]);
+void Matrix::TransformVectors(const float* in,
+                              float* out,
+                              size_t count) const {
+  Row r0 = LoadRow(m_[0]);
+  Row r1 = LoadRow(m_[1]);
+  Row r2 = LoadRow(m_[2]);
+  Row r3 = LoadRow(m_[3]);
+  for (size_t i = 0; i < count; i++) {
+    Row result = Combine(in + i * 4, r0, r1, r2, r3);
+    // |in| may be unaligned, and may be |out|.
+    float values[4];
+    StoreRow(values, result);
+    std::copy(values, values + 4, out + i * 4);
   }
-  std::copy(&tmp.m_[0][0], &tmp.m_[3][3] + 1, &m_[0][0]);
 }
 
 void Matrix::Scale(float sx, float sy, float sz) {
-  m_[0][0] *= sx;
-  m_[0][1] *= sx;
-  m_[0][2] *= sx;
-  m_[0][3] *= sx;
-
-  m_[1][0] *= sy;
-  m_[1][1] *= sy;
-  m_[1][2] *= sy;
-  m_[1][3] *= sy;
-
-  m_[2][0] *= sz;
-  m_[2][1] *= sz;
-  m_[2][2] *= sz;
-  m_[2][3] *= sz;
+  StoreRow(m_[0], MulRow(LoadRow(m_[0]), sx));
+  StoreRow(m_[1], MulRow(LoadRow(m_[1]), sy));
+  StoreRow(m_[2], MulRow(LoadRow(m_[2]), sz));
 }
 
 void Matrix::Translate(float tx, float ty, float tz) {
-  m_[3][0] += (m_[0][0] * tx + m_[1][0] * ty + m_[2][0] * tz);
-  m_[3][1] += (m_[0][1] * tx + m_[1][1] * ty + m_[2][1] * tz);
-  m_[3][2] += (m_[0][2] * tx + m_[1][2] * ty + m_[2][2] * tz);
-  m_[3][3] += (m_[0][3] * tx + m_[1][3] * ty + m_[2][3] * tz);
+  const float t[3] = {tx, ty, tz};
+  Row translation =
+      Combine3(t, LoadRow(m_[0]), LoadRow(m_[1]), LoadRow(m_[2]));
+  StoreRow(m_[3], AddRow(LoadRow(m_[3]), translation));
 }
 
 void Matrix::Rotate(float angle, float x, float y, float z) {
-  float mag = sqrt(x * x + y * y + z * z);
+  float mag = sqrtf(x * x + y * y + z * z);
   if (mag > 0.0f) {
     float xx, yy, zz, xy, yz, zx, xs, ys, zs;
-    Matrix rot_mat;
 
     x /= mag;
     y /= mag;
@@ -137,38 +330,47 @@ void Matrix::Rotate(float angle, float x, float y, float z) {
     xy = x * y;
     yz = y * z;
     zx = z * x;
-    float sin_angle = sin(angle * M_PI / 180.0f);
-    float cos_angle = cos(angle * M_PI / 180.0f);
+    float sin_angle, cos_angle;
+    SinCos(angle, &sin_angle, &cos_angle);
     xs = x * sin_angle;
     ys = y * sin_angle;
     zs = z * sin_angle;
     float one_cos = 1.0f - cos_angle;
 
-    rot_mat.m_[0][0] = (one_cos * xx) + cos_angle;
-    rot_mat.m_[0][1] = (one_cos * xy) - zs;
-    rot_mat.m_[0][2] = (one_cos * zx) + ys;
-    rot_mat.m_[0][3] = 0.0F;
-
-    rot_mat.m_[1][0] = (one_cos * xy) + zs;
-    rot_mat.m_[1][1] = (one_cos * yy) + cos_angle;
-    rot_mat.m_[1][2] = (one_cos * yz) - xs;
-    rot_mat.m_[1][3] = 0.0F;
-
-    rot_mat.m_[2][0] = (one_cos * zx) - ys;
-    rot_mat.m_[2][1] = (one_cos * yz) + xs;
-    rot_mat.m_[2][2] = (one_cos * zz) + cos_angle;
-    rot_mat.m_[2][3] = 0.0F;
-
-    rot_mat.m_[3][0] = 0.0F;
-    rot_mat.m_[3][1] = 0.0F;
-    rot_mat.m_[3][2] = 0.0F;
-    rot_mat.m_[3][3] = 1.0F;
-
-    rot_mat.MatrixMultiply(*this);
-    *this = rot_mat;
+    // The upper 3x3 of the rotation matrix. The rest is the identity, so
+    // rotation * this leaves the last row alone and only mixes the others.
+    const float rot[3][3] = {
+        {(one_cos * xx) + cos_angle, (one_cos * xy) - zs, (one_cos * zx) + ys},
+        {(one_cos * xy) + zs, (one_cos * yy) + cos_angle, (one_cos * yz) - xs},
+        {(one_cos * zx) - ys, (one_cos * yz) + xs, (one_cos * zz) + cos_angle},
+    };
+
+    Row r0 = LoadRow(m_[0]);
+    Row r1 = LoadRow(m_[1]);
+    Row r2 = LoadRow(m_[2]);
+    for (int i = 0; i < 3; i++)
+      StoreRow(m_[i], Combine3(rot[i], r0, r1, r2));
   }
 }
 
+template <Matrix::Axis axis>
+void Matrix::Rotate(float angle) {
+  // Rotate() about the axis mixes rows |a| and |b| only.
+  const int a = axis == Axis::X ? 1 : (axis == Axis::Y ? 2 : 0);
+  const int b = axis == Axis::X ? 2 : (axis == Axis::Y ? 0 : 1);
+  float sin_angle, cos_angle;
+  SinCos(angle, &sin_angle, &cos_angle);
+
+  Row ra = LoadRow(m_[a]);
+  Row rb = LoadRow(m_[b]);
+  StoreRow(m_[a], MulAddRow(MulRow(ra, cos_angle), rb, -sin_angle));
+  StoreRow(m_[b], MulAddRow(MulRow(ra, sin_angle), rb, cos_angle));
+}
+
+template void Matrix::Rotate<Matrix::Axis::X>(float angle);
+template void Matrix::Rotate<Matrix::Axis::Y>(float angle);
+template void Matrix::Rotate<Matrix::Axis::Z>(float angle);
+
 void Matrix::Frustum(float left,
                      float right,
                      float bottom,
@@ -23,22 +23,67 @@
 #ifndef GED_MATRIX_H
 #define GED_MATRIX_H
 
+#include <cstddef>
+
 namespace ged {
 
+/*
+ * Matrix is a 4x4 float matrix laid out for glUniformMatrix4fv(). The math
+ * uses SSE or NEON on whole rows, so the rows are 16 byte aligned.
+ */
 class Matrix {
  public:
+  struct Vector3 {
+    float x;
+    float y;
+    float z;
+  };
+  enum class Axis { X, Y, Z };
+
   Matrix();
   ~Matrix();
   Matrix(const Matrix&) = default;
   void operator=(const Matrix&);
 
+  // Builds what Translate(|translation|), then Rotate() about the x, y and z
+  // axes by |degrees|, and then Scale(|scale|) build, but straight into the
+  // result with one sincosf() per angle.
+  static Matrix FromTRS(const Vector3& translation,
+                        const Vector3& degrees,
+                        const Vector3& scale);
+  // FromTRS() without translation and scale.
+  static Matrix FromEuler(const Vector3& degrees);
+
   const float* Data() const;
   void Get3x3(float* m3x3) const;
+  // The inverse transpose of the upper 3x3, which keeps normals perpendicular
+  // under non-uniform scale. Falls back to Get3x3() and returns false if the
+  // matrix isn't invertible.
+  bool GetNormalMatrix(float* m3x3) const;
 
   void MatrixMultiply(const Matrix& op);
+
+  // Batch versions for scenes with many objects. out[i] = a[i] * b[i] as
+  // MatrixMultiply() does; |out| can be |a| or |b|.
+  static void MultiplyArray(const Matrix* a,
+                            const Matrix* b,
+                            Matrix* out,
+                            size_t count);
+  // out[i] = a[i] * b, e.g. every modelview by one projection.
+  static void MultiplyArray(const Matrix* a,
+                            const Matrix& b,
+                            Matrix* out,
+                            size_t count);
+  // Transforms |count| vec4s as "matrix * vector" in GLSL does. |out| can be
+  // |in|.
+  void TransformVectors(const float* in, float* out, size_t count) const;
+
   void Scale(float sx, float sy, float sz);
   void Translate(float tx, float ty, float tz);
   void Rotate(float angle, float x, float y, float z);
+  // Rotate() about a fixed axis, which touches only the two rows it mixes.
+  template <Axis axis>
+  void Rotate(float angle);
 
   // \brief multiply matrix specified by result with a perspective matrix and
   // return new matrix in result
@@ -69,7 +114,7 @@ class Matrix {
 
  private:
   void InitIdentity();
-  float m_[4][4];
+  alignas(16) float m_[4][4];
 };
 
 }  // namespace ged
@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define GED_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ged {
+namespace pixel {
+
+namespace {
+
+struct Kernels {
+  ISA isa;
+  void (*fill)(uint32_t* dst, size_t count, uint32_t color);
+  void (*copy)(uint8_t* dst, const uint8_t* src, size_t bytes);
+  void (*xrgb_to_argb)(uint32_t* dst, const uint32_t* src, size_t count);
+  void (*argb_to_rgb565)(uint16_t* dst, const uint32_t* src, size_t count);
+  void (*rgb565_to_argb)(uint32_t* dst, const uint16_t* src, size_t count);
+  void (*premultiply)(uint32_t* dst, const uint32_t* src, size_t count);
+  // Non-temporal versions of |fill| and |copy|.
+  void (*stream_fill)(uint32_t* dst, size_t count, uint32_t color);
+  void (*stream_copy)(uint8_t* dst, const uint8_t* src, size_t bytes);
+  void (*stream_fence)();
+};
+
+const uint32_t kAlphaMask = 0xff000000;
+
+// The per pixel math, which the SIMD variants use for the leftover pixels.
+
+inline uint16_t ToRGB565(uint32_t p) {
+  return ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f);
+}
+
+inline uint32_t FromRGB565(uint16_t p) {
+  uint32_t r = (p >> 11) & 0x1f;
+  uint32_t g = (p >> 5) & 0x3f;
+  uint32_t b = p & 0x1f;
+  return kAlphaMask | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 |
+         (b << 3 | b >> 2);
+}
+
+// c * a / 255, rounded to nearest without a division.
+inline uint32_t MulDiv255(uint32_t c, uint32_t a) {
+  uint32_t t = c * a + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+inline uint32_t PremultiplyPixel(uint32_t p) {
+  uint32_t a = p >> 24;
+  return (p & kAlphaMask) | MulDiv255((p >> 16) & 0xff, a) << 16 |
+         MulDiv255((p >> 8) & 0xff, a) << 8 | MulDiv255(p & 0xff, a);
+}
+
+void FillScalar(uint32_t* dst, size_t count, uint32_t color) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = color;
+}
+
+void CopyScalar(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  std::memcpy(dst, src, bytes);
+}
+
+void XRGBToARGBScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = src[i] | kAlphaMask;
+}
+
+void ARGBToRGB565Scalar(uint16_t* dst, const uint32_t* src, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = ToRGB565(src[i]);
+}
+
+void RGB565ToARGBScalar(uint32_t* dst, const uint16_t* src, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = FromRGB565(src[i]);
+}
+
+void PremultiplyScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = PremultiplyPixel(src[i]);
+}
+
+// Plain stores need no fence.
+void StreamFenceScalar() {}
+
+const Kernels kScalarKernels = {
+    ISA::SCALAR,       FillScalar,         CopyScalar,
+    XRGBToARGBScalar,  ARGBToRGB565Scalar, RGB565ToARGBScalar,
+    PremultiplyScalar, FillScalar,         CopyScalar,
+    StreamFenceScalar,
+};
+
+#if defined(__SSE2__)
+
+inline __m128i Load128(const void* src) {
+  return _mm_loadu_si128(static_cast<const __m128i*>(src));
+}
+
+inline void Store128(void* dst, __m128i value) {
+  _mm_storeu_si128(static_cast<__m128i*>(dst), value);
+}
+
+void FillSSE2(uint32_t* dst, size_t count, uint32_t color) {
+  __m128i value = _mm_set1_epi32(color);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    Store128(dst + i, value);
+  FillScalar(dst + i, count - i, color);
+}
+
+void CopySSE2(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16)
+    Store128(dst + i, Load128(src + i));
+  CopyScalar(dst + i, src + i, bytes - i);
+}
+
+void XRGBToARGBSSE2(uint32_t* dst, const uint32_t* src, size_t count) {
+  __m128i alpha = _mm_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    Store128(dst + i, _mm_or_si128(Load128(src + i), alpha));
+  XRGBToARGBScalar(dst + i, src + i, count - i);
+}
+
+// Returns RGB565 in the low half of each 32 bit lane, sign extended so that
+// the signed saturation of _mm_packs_epi32() keeps every bit.
+inline __m128i ToRGB565x4(__m128i p) {
+  __m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xf800));
+  __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0));
+  __m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001f));
+  __m128i rgb = _mm_or_si128(r, _mm_or_si128(g, b));
+  return _mm_srai_epi32(_mm_slli_epi32(rgb, 16), 16);
+}
+
+void ARGBToRGB565SSE2(uint16_t* dst, const uint32_t* src, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i lo = ToRGB565x4(Load128(src + i));
+    __m128i hi = ToRGB565x4(Load128(src + i + 4));
+    Store128(dst + i, _mm_packs_epi32(lo, hi));
+  }
+  ARGBToRGB565Scalar(dst + i, src + i, count - i);
+}
+
+// |p| has RGB565 zero extended to 32 bit lanes.
+inline __m128i FromRGB565x4(__m128i p) {
+  __m128i r = _mm_or_si128(
+      _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xf800)), 8),
+      _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xe000)), 3));
+  __m128i g = _mm_or_si128(
+      _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x07e0)), 5),
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x0600)), 1));
+  __m128i b = _mm_or_si128(
+      _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x001f)), 3),
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x001c)), 2));
+  return _mm_or_si128(_mm_set1_epi32(kAlphaMask),
+                      _mm_or_si128(r, _mm_or_si128(g, b)));
+}
+
+void RGB565ToARGBSSE2(uint32_t* dst, const uint16_t* src, size_t count) {
+  __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i p = Load128(src + i);
+    Store128(dst + i, FromRGB565x4(_mm_unpacklo_epi16(p, zero)));
+    Store128(dst + i + 4, FromRGB565x4(_mm_unpackhi_epi16(p, zero)));
+  }
+  RGB565ToARGBScalar(dst + i, src + i, count - i);
+}
+
+// MulDiv255() on 16 bit lanes.
+inline __m128i MulDiv255x8(__m128i c, __m128i a) {
+  __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// Premultiplies two pixels unpacked to 16 bit lanes.
+inline __m128i Premultiplyx2(__m128i c) {
+  const int kAlpha = _MM_SHUFFLE(3, 3, 3, 3);
+  __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, kAlpha), kAlpha);
+  return MulDiv255x8(c, a);
+}
+
+void PremultiplySSE2(uint32_t* dst, const uint32_t* src, size_t count) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i alpha = _mm_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i p = Load128(src + i);
+    __m128i lo = Premultiplyx2(_mm_unpacklo_epi8(p, zero));
+    __m128i hi = Premultiplyx2(_mm_unpackhi_epi8(p, zero));
+    __m128i rgb = _mm_andnot_si128(alpha, _mm_packus_epi16(lo, hi));
+    Store128(dst + i, _mm_or_si128(rgb, _mm_and_si128(p, alpha)));
+  }
+  PremultiplyScalar(dst + i, src + i, count - i);
+}
+
+const size_t kCacheLineSize = 64;
+
+inline size_t Misalignment(const void* ptr, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(ptr) & (alignment - 1);
+}
+
+// Bytes from |ptr| to the next |alignment| boundary, at most |bytes|.
+inline size_t BytesToAlignment(const void* ptr,
+                               size_t alignment,
+                               size_t bytes) {
+  return std::min(bytes, (alignment - Misalignment(ptr, alignment)) &
+                             (alignment - 1));
+}
+
+// Writes the first partial line with plain stores and then whole lines with
+// _mm_stream_si128(), so that every write combining buffer leaves the core
+// full in one burst.
+void StreamFillSSE2(uint32_t* dst, size_t count, uint32_t color) {
+  __m128i value = _mm_set1_epi32(color);
+  size_t head = BytesToAlignment(dst, kCacheLineSize, count * 4) / 4;
+  FillScalar(dst, head, color);
+  size_t i = head;
+  if (!Misalignment(dst + i, 16)) {
+    for (; i + 16 <= count; i += 16) {
+      __m128i* line = reinterpret_cast<__m128i*>(dst + i);
+      _mm_stream_si128(line, value);
+      _mm_stream_si128(line + 1, value);
+      _mm_stream_si128(line + 2, value);
+      _mm_stream_si128(line + 3, value);
+    }
+  }
+  FillSSE2(dst + i, count - i, color);
+}
+
+void StreamCopySSE2(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  size_t i = BytesToAlignment(dst, kCacheLineSize, bytes);
+  CopySSE2(dst, src, i);
+  for (; i + kCacheLineSize <= bytes; i += kCacheLineSize) {
+    __m128i* line = reinterpret_cast<__m128i*>(dst + i);
+    __m128i v0 = Load128(src + i);
+    __m128i v1 = Load128(src + i + 16);
+    __m128i v2 = Load128(src + i + 32);
+    __m128i v3 = Load128(src + i + 48);
+    _mm_stream_si128(line, v0);
+    _mm_stream_si128(line + 1, v1);
+    _mm_stream_si128(line + 2, v2);
+    _mm_stream_si128(line + 3, v3);
+  }
+  CopySSE2(dst + i, src + i, bytes - i);
+}
+
+void StreamFenceSSE2() {
+  _mm_sfence();
+}
+
+const Kernels kSSE2Kernels = {
+    ISA::SSE2,       FillSSE2,         CopySSE2,
+    XRGBToARGBSSE2,  ARGBToRGB565SSE2, RGB565ToARGBSSE2,
+    PremultiplySSE2, StreamFillSSE2,   StreamCopySSE2,
+    StreamFenceSSE2,
+};
+
+// The same as SSE2 on twice the lanes. Unpacks and packs work within each
+// 128 bit half, so the pixel order only needs fixing for RGB565.
+
+GED_AVX2 inline __m256i Load256(const void* src) {
+  return _mm256_loadu_si256(static_cast<const __m256i*>(src));
+}
+
+GED_AVX2 inline void Store256(void* dst, __m256i value) {
+  _mm256_storeu_si256(static_cast<__m256i*>(dst), value);
+}
+
+GED_AVX2 void FillAVX2(uint32_t* dst, size_t count, uint32_t color) {
+  __m256i value = _mm256_set1_epi32(color);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    Store256(dst + i, value);
+  FillScalar(dst + i, count - i, color);
+}
+
+GED_AVX2 void CopyAVX2(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  size_t i = 0;
+  for (; i + 32 <= bytes; i += 32)
+    Store256(dst + i, Load256(src + i));
+  CopyScalar(dst + i, src + i, bytes - i);
+}
+
+GED_AVX2 void XRGBToARGBAVX2(uint32_t* dst,
+                             const uint32_t* src,
+                             size_t count) {
+  __m256i alpha = _mm256_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    Store256(dst + i, _mm256_or_si256(Load256(src + i), alpha));
+  XRGBToARGBScalar(dst + i, src + i, count - i);
+}
+
+GED_AVX2 inline __m256i ToRGB565x8(__m256i p) {
+  __m256i r =
+      _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xf800));
+  __m256i g =
+      _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0));
+  __m256i b =
+      _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001f));
+  __m256i rgb = _mm256_or_si256(r, _mm256_or_si256(g, b));
+  return _mm256_srai_epi32(_mm256_slli_epi32(rgb, 16), 16);
+}
+
+GED_AVX2 void ARGBToRGB565AVX2(uint16_t* dst,
+                               const uint32_t* src,
+                               size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i lo = ToRGB565x8(Load256(src + i));
+    __m256i hi = ToRGB565x8(Load256(src + i + 8));
+    __m256i packed = _mm256_packs_epi32(lo, hi);
+    packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+    Store256(dst + i, packed);
+  }
+  ARGBToRGB565Scalar(dst + i, src + i, count - i);
+}
+
+GED_AVX2 inline __m256i FromRGB565x8(__m256i p) {
+  __m256i r = _mm256_or_si256(
+      _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xf800)), 8),
+      _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xe000)), 3));
+  __m256i g = _mm256_or_si256(
+      _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0x07e0)), 5),
+      _mm256_srli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0x0600)), 1));
+  __m256i b = _mm256_or_si256(
+      _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0x001f)), 3),
+      _mm256_srli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0x001c)), 2));
+  return _mm256_or_si256(_mm256_set1_epi32(kAlphaMask),
+                         _mm256_or_si256(r, _mm256_or_si256(g, b)));
+}
+
+GED_AVX2 void RGB565ToARGBAVX2(uint32_t* dst,
+                               const uint16_t* src,
+                               size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    Store256(dst + i, FromRGB565x8(_mm256_cvtepu16_epi32(Load128(src + i))));
+  RGB565ToARGBScalar(dst + i, src + i, count - i);
+}
+
+GED_AVX2 inline __m256i MulDiv255x16(__m256i c, __m256i a) {
+  __m256i t =
+      _mm256_add_epi16(_mm256_mullo_epi16(c, a), _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+GED_AVX2 inline __m256i Premultiplyx4(__m256i c) {
+  const int kAlpha = _MM_SHUFFLE(3, 3, 3, 3);
+  __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, kAlpha), kAlpha);
+  return MulDiv255x16(c, a);
+}
+
+GED_AVX2 void PremultiplyAVX2(uint32_t* dst,
+                              const uint32_t* src,
+                              size_t count) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i alpha = _mm256_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i p = Load256(src + i);
+    __m256i lo = Premultiplyx4(_mm256_unpacklo_epi8(p, zero));
+    __m256i hi = Premultiplyx4(_mm256_unpackhi_epi8(p, zero));
+    __m256i rgb = _mm256_andnot_si256(alpha, _mm256_packus_epi16(lo, hi));
+    Store256(dst + i, _mm256_or_si256(rgb, _mm256_and_si256(p, alpha)));
+  }
+  PremultiplyScalar(dst + i, src + i, count - i);
+}
+
+GED_AVX2 void StreamFillAVX2(uint32_t* dst, size_t count, uint32_t color) {
+  __m256i value = _mm256_set1_epi32(color);
+  size_t head = BytesToAlignment(dst, kCacheLineSize, count * 4) / 4;
+  FillScalar(dst, head, color);
+  size_t i = head;
+  if (!Misalignment(dst + i, 32)) {
+    for (; i + 16 <= count; i += 16) {
+      __m256i* line = reinterpret_cast<__m256i*>(dst + i);
+      _mm256_stream_si256(line, value);
+      _mm256_stream_si256(line + 1, value);
+    }
+  }
+  FillAVX2(dst + i, count - i, color);
+}
+
+GED_AVX2 void StreamCopyAVX2(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  size_t i = BytesToAlignment(dst, kCacheLineSize, bytes);
+  CopyAVX2(dst, src, i);
+  for (; i + kCacheLineSize <= bytes; i += kCacheLineSize) {
+    __m256i* line = reinterpret_cast<__m256i*>(dst + i);
+    __m256i v0 = Load256(src + i);
+    __m256i v1 = Load256(src + i + 32);
+    _mm256_stream_si256(line, v0);
+    _mm256_stream_si256(line + 1, v1);
+  }
+  CopyAVX2(dst + i, src + i, bytes - i);
+}
+
+const Kernels kAVX2Kernels = {
+    ISA::AVX2,       FillAVX2,         CopyAVX2,
+    XRGBToARGBAVX2,  ARGBToRGB565AVX2, RGB565ToARGBAVX2,
+    PremultiplyAVX2, StreamFillAVX2,   StreamCopyAVX2,
+    StreamFenceSSE2,
+};
+
+#endif  // defined(__SSE2__)
+
+#if defined(__ARM_NEON)
+
+void FillNEON(uint32_t* dst, size_t count, uint32_t color) {
+  uint32x4_t value = vdupq_n_u32(color);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_u32(dst + i, value);
+  FillScalar(dst + i, count - i, color);
+}
+
+void CopyNEON(uint8_t* dst, const uint8_t* src, size_t bytes) {
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16)
+    vst1q_u8(dst + i, vld1q_u8(src + i));
+  CopyScalar(dst + i, src + i, bytes - i);
+}
+
+void XRGBToARGBNEON(uint32_t* dst, const uint32_t* src, size_t count) {
+  uint32x4_t alpha = vdupq_n_u32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), alpha));
+  XRGBToARGBScalar(dst + i, src + i, count - i);
+}
+
+// vld4_u8() splits ARGB8888 into the B, G, R and A planes.
+void ARGBToRGB565NEON(uint16_t* dst, const uint32_t* src, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t p = vld4_u8(reinterpret_cast<const uint8_t*>(src + i));
+    uint16x8_t rgb = vshll_n_u8(p.val[2], 8);
+    rgb = vsriq_n_u16(rgb, vshll_n_u8(p.val[1], 8), 5);
+    rgb = vsriq_n_u16(rgb, vshll_n_u8(p.val[0], 8), 11);
+    vst1q_u16(dst + i, rgb);
+  }
+  ARGBToRGB565Scalar(dst + i, src + i, count - i);
+}
+
+void RGB565ToARGBNEON(uint32_t* dst, const uint16_t* src, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t p = vld1q_u16(src + i);
+    uint8x8x4_t argb;
+    uint8x8_t r = vand_u8(vshrn_n_u16(p, 8), vdup_n_u8(0xf8));
+    uint8x8_t g = vand_u8(vshrn_n_u16(p, 3), vdup_n_u8(0xfc));
+    uint8x8_t b = vmovn_u16(vshlq_n_u16(p, 3));
+    argb.val[0] = vsri_n_u8(b, b, 5);
+    argb.val[1] = vsri_n_u8(g, g, 6);
+    argb.val[2] = vsri_n_u8(r, r, 5);
+    argb.val[3] = vdup_n_u8(0xff);
+    vst4_u8(reinterpret_cast<uint8_t*>(dst + i), argb);
+  }
+  RGB565ToARGBScalar(dst + i, src + i, count - i);
+}
+
+void PremultiplyNEON(uint32_t* dst, const uint32_t* src, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t p = vld4_u8(reinterpret_cast<const uint8_t*>(src + i));
+    for (int c = 0; c < 3; ++c) {
+      // The same rounding as MulDiv255().
+      uint16x8_t t = vmull_u8(p.val[c], p.val[3]);
+      p.val[c] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+    }
+    vst4_u8(reinterpret_cast<uint8_t*>(dst + i), p);
+  }
+  PremultiplyScalar(dst + i, src + i, count - i);
+}
+
+// The NEON intrinsics have no non-temporal store, and plain vector stores
+// already fill the write buffer in whole lines.
+const Kernels kNEONKernels = {
+    ISA::NEON,       FillNEON,         CopyNEON,
+    XRGBToARGBNEON,  ARGBToRGB565NEON, RGB565ToARGBNEON,
+    PremultiplyNEON, FillNEON,         CopyNEON,
+    StreamFenceScalar,
+};
+
+#endif  // defined(__ARM_NEON)
+
+// From the fastest.
+const ISA kPreferredISAs[] = {ISA::AVX2, ISA::SSE2, ISA::NEON, ISA::SCALAR};
+
+const Kernels* GetKernelsFor(ISA isa) {
+  switch (isa) {
+    case ISA::SCALAR:
+      return &kScalarKernels;
+#if defined(__SSE2__)
+    case ISA::SSE2:
+      return &kSSE2Kernels;
+    case ISA::AVX2:
+      return &kAVX2Kernels;
+#endif
+#if defined(__ARM_NEON)
+    case ISA::NEON:
+      return &kNEONKernels;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+std::atomic<const Kernels*> g_kernels{nullptr};
+
+const Kernels& GetKernels() {
+  const Kernels* kernels = g_kernels.load(std::memory_order_acquire);
+  if (kernels)
+    return *kernels;
+  for (ISA isa : kPreferredISAs) {
+    if (IsSupported(isa)) {
+      kernels = GetKernelsFor(isa);
+      break;
+    }
+  }
+  g_kernels.store(kernels, std::memory_order_release);
+  return *kernels;
+}
+
+typedef void (*CopyFunction)(uint8_t* dst, const uint8_t* src, size_t bytes);
+
+void FillPatternWith(CopyFunction copy,
+                     uint32_t* dst,
+                     size_t count,
+                     const uint32_t* pattern,
+                     size_t pattern_length,
+                     size_t phase) {
+  if (!pattern_length)
+    return;
+  phase %= pattern_length;
+  while (count) {
+    size_t length = std::min(count, pattern_length - phase);
+    copy(reinterpret_cast<uint8_t*>(dst),
+         reinterpret_cast<const uint8_t*>(pattern + phase),
+         length * sizeof(uint32_t));
+    dst += length;
+    count -= length;
+    phase = 0;
+  }
+}
+
+void BlitWith(CopyFunction copy,
+              uint8_t* dst,
+              size_t dst_stride,
+              const uint8_t* src,
+              size_t src_stride,
+              size_t row_bytes,
+              size_t height) {
+  for (size_t y = 0; y < height; ++y)
+    copy(dst + y * dst_stride, src + y * src_stride, row_bytes);
+}
+
+}  // namespace
+
+ISA GetISA() {
+  return GetKernels().isa;
+}
+
+bool SetISA(ISA isa) {
+  if (!IsSupported(isa))
+    return false;
+  g_kernels.store(GetKernelsFor(isa), std::memory_order_release);
+  return true;
+}
+
+bool IsSupported(ISA isa) {
+  if (!GetKernelsFor(isa))
+    return false;
+#if defined(__SSE2__)
+  if (isa == ISA::AVX2) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }
+#endif
+  return true;
+}
+
+const char* GetISAName(ISA isa) {
+  switch (isa) {
+    case ISA::SCALAR:
+      return "scalar";
+    case ISA::SSE2:
+      return "sse2";
+    case ISA::AVX2:
+      return "avx2";
+    case ISA::NEON:
+      return "neon";
+  }
+  return "unknown";
+}
+
+void Fill(uint32_t* dst, size_t count, uint32_t color) {
+  GetKernels().fill(dst, count, color);
+}
+
+void FillRect(uint8_t* dst,
+              size_t stride,
+              size_t width,
+              size_t height,
+              uint32_t color) {
+  const Kernels& kernels = GetKernels();
+  for (size_t y = 0; y < height; ++y)
+    kernels.fill(reinterpret_cast<uint32_t*>(dst + y * stride), width, color);
+}
+
+void FillPattern(uint32_t* dst,
+                 size_t count,
+                 const uint32_t* pattern,
+                 size_t pattern_length,
+                 size_t phase) {
+  FillPatternWith(GetKernels().copy, dst, count, pattern, pattern_length,
+                  phase);
+}
+
+void Blit(uint8_t* dst,
+          size_t dst_stride,
+          const uint8_t* src,
+          size_t src_stride,
+          size_t row_bytes,
+          size_t height) {
+  BlitWith(GetKernels().copy, dst, dst_stride, src, src_stride, row_bytes,
+           height);
+}
+
+void XRGBToARGB(uint32_t* dst, const uint32_t* src, size_t count) {
+  GetKernels().xrgb_to_argb(dst, src, count);
+}
+
+void ARGBToRGB565(uint16_t* dst, const uint32_t* src, size_t count) {
+  GetKernels().argb_to_rgb565(dst, src, count);
+}
+
+void RGB565ToARGB(uint32_t* dst, const uint16_t* src, size_t count) {
+  GetKernels().rgb565_to_argb(dst, src, count);
+}
+
+void Premultiply(uint32_t* dst, const uint32_t* src, size_t count) {
+  GetKernels().premultiply(dst, src, count);
+}
+
+void StreamFill(uint32_t* dst, size_t count, uint32_t color) {
+  GetKernels().stream_fill(dst, count, color);
+}
+
+void StreamFillPattern(uint32_t* dst,
+                       size_t count,
+                       const uint32_t* pattern,
+                       size_t pattern_length,
+                       size_t phase) {
+  FillPatternWith(GetKernels().stream_copy, dst, count, pattern,
+                  pattern_length, phase);
+}
+
+void StreamBlit(uint8_t* dst,
+                size_t dst_stride,
+                const uint8_t* src,
+                size_t src_stride,
+                size_t row_bytes,
+                size_t height) {
+  BlitWith(GetKernels().stream_copy, dst, dst_stride, src, src_stride,
+           row_bytes, height);
+}
+
+void StreamFence() {
+  GetKernels().stream_fence();
+}
+
+}  // namespace pixel
+}  // namespace ged
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_PIXEL_KERNELS_H_
+#define GED_PIXEL_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ged {
+
+/*
+ * Pixel kernels are the inner loops of CPU produced textures. Each one has
+ * SSE2, AVX2 and NEON variants besides the plain C++ one, and the fastest
+ * variant the CPU runs is picked on first use.
+ *
+ * Pixels are DRM_FORMAT_ARGB8888 (or XRGB8888) and RGB565, i.e. native endian
+ * uint32_t 0xAARRGGBB and uint16_t. Every variant gives bit-exact results.
+ * The 32 bit to 32 bit conversions can work in place.
+ */
+namespace pixel {
+
+enum class ISA { SCALAR, SSE2, AVX2, NEON };
+
+// The variant in use.
+ISA GetISA();
+// Forces every kernel to |isa|, e.g. to compare variants. Returns false if
+// this CPU can't run it.
+bool SetISA(ISA isa);
+bool IsSupported(ISA isa);
+const char* GetISAName(ISA isa);
+
+void Fill(uint32_t* dst, size_t count, uint32_t color);
+void FillRect(uint8_t* dst,
+              size_t stride,
+              size_t width,
+              size_t height,
+              uint32_t color);
+
+// Repeats the |pattern_length| pixels of |pattern|, starting from its
+// |phase|-th pixel.
+void FillPattern(uint32_t* dst,
+                 size_t count,
+                 const uint32_t* pattern,
+                 size_t pattern_length,
+                 size_t phase);
+
+// Copies |height| rows of |row_bytes| between buffers of different strides,
+// e.g. into a StreamTexture of Dimension::stride.
+void Blit(uint8_t* dst,
+          size_t dst_stride,
+          const uint8_t* src,
+          size_t src_stride,
+          size_t row_bytes,
+          size_t height);
+
+// Sets the alpha to opaque.
+void XRGBToARGB(uint32_t* dst, const uint32_t* src, size_t count);
+// Drops the low bits of each channel, and the alpha.
+void ARGBToRGB565(uint16_t* dst, const uint32_t* src, size_t count);
+// Replicates the high bits into the low ones, so that white stays white.
+void RGB565ToARGB(uint32_t* dst, const uint16_t* src, size_t count);
+// Multiplies the color channels by alpha / 255, rounded to nearest.
+void Premultiply(uint32_t* dst, const uint32_t* src, size_t count);
+
+// The same as Fill(), FillPattern() and Blit(), for write-combined or uncached
+// memory like a StreamTexture mapping. They write whole cache lines with
+// non-temporal stores where the CPU has them, which neither read nor pollute
+// the cache. Call StreamFence() on the same thread before another thread or
+// the GPU reads the memory.
+void StreamFill(uint32_t* dst, size_t count, uint32_t color);
+void StreamFillPattern(uint32_t* dst,
+                       size_t count,
+                       const uint32_t* pattern,
+                       size_t pattern_length,
+                       size_t phase);
+void StreamBlit(uint8_t* dst,
+                size_t dst_stride,
+                const uint8_t* src,
+                size_t src_stride,
+                size_t row_bytes,
+                size_t height);
+void StreamFence();
+
+}  // namespace pixel
+
+}  // namespace ged
+
+#endif  // GED_PIXEL_KERNELS_H_
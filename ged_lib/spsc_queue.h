@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_SPSC_QUEUE_H_
+#define GED_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace ged {
+
+/*
+ * SPSCQueue is a bounded lock-free queue for exactly one producer thread and
+ * one consumer thread. Everything the producer wrote before Push() is visible
+ * to the consumer after the matching Pop(), so it can hand over the ownership
+ * of a buffer together with the queued value.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue {
+ public:
+  SPSCQueue() = default;
+  SPSCQueue(const SPSCQueue&) = delete;
+  void operator=(const SPSCQueue&) = delete;
+
+  // Called only by the producer. Returns false if the queue is full.
+  bool Push(const T& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = Next(tail);
+    if (next == head_.load(std::memory_order_acquire))
+      return false;
+    items_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Called only by the consumer. Returns false if the queue is empty.
+  bool Pop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = items_[head];
+    head_.store(Next(head), std::memory_order_release);
+    return true;
+  }
+
+ private:
+  // One slot is always left empty to tell a full queue from an empty one.
+  static const size_t kSlots = Capacity + 1;
+  static size_t Next(size_t index) { return (index + 1) % kSlots; }
+
+  T items_[kSlots];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+}  // namespace ged
+
+#endif  // GED_SPSC_QUEUE_H_
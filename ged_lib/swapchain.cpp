@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "swapchain.h"
+
+#include <cassert>
+
+namespace ged {
+
+Swapchain::Swapchain(size_t num_buffers)
+    : states_(num_buffers, State::FREE) {
+  assert(num_buffers >= kMinBuffers && num_buffers <= kMaxBuffers);
+  states_[scanout_buffer_] = State::SCANOUT;
+}
+
+Swapchain::~Swapchain() {}
+
+bool Swapchain::HasFreeBuffer() const {
+  for (State state : states_) {
+    if (state == State::FREE)
+      return true;
+  }
+  return false;
+}
+
+size_t Swapchain::GetFramesAhead() const {
+  size_t count = 0;
+  for (State state : states_) {
+    if (state == State::RENDERING || state == State::QUEUED ||
+        state == State::PENDING_FLIP) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int Swapchain::AcquireBuffer() {
+  for (size_t i = 0; i < states_.size(); i++) {
+    if (states_[i] == State::FREE) {
+      states_[i] = State::RENDERING;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Swapchain::QueueBuffer(int buffer) {
+  assert(states_[buffer] == State::RENDERING);
+  states_[buffer] = State::QUEUED;
+  queued_buffers_.push_back(buffer);
+}
+
+int Swapchain::BeginFlip() {
+  assert(pending_buffer_ == -1);
+  if (queued_buffers_.empty())
+    return -1;
+
+  pending_buffer_ = queued_buffers_.front();
+  queued_buffers_.pop_front();
+  states_[pending_buffer_] = State::PENDING_FLIP;
+  return pending_buffer_;
+}
+
+void Swapchain::DidFlip() {
+  assert(pending_buffer_ != -1);
+  if (scanout_buffer_ != -1)
+    states_[scanout_buffer_] = State::FREE;
+  scanout_buffer_ = pending_buffer_;
+  states_[scanout_buffer_] = State::SCANOUT;
+  pending_buffer_ = -1;
+}
+
+int Swapchain::ReleaseScanoutBuffer() {
+  assert(pending_buffer_ != -1);
+  int buffer = scanout_buffer_;
+  if (buffer != -1)
+    states_[buffer] = State::FREE;
+  scanout_buffer_ = -1;
+  return buffer;
+}
+
+}  // namespace ged
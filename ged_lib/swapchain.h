@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_SWAPCHAIN_H_
+#define GED_SWAPCHAIN_H_
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace ged {
+
+/*
+ * Swapchain tracks which framebuffer is where between the client and the
+ * display. It only deals with buffer indices; the buffers themselves are
+ * owned by the caller.
+ *
+ * A buffer cycles through the states in this order:
+ *   FREE -> RENDERING -> QUEUED -> PENDING_FLIP -> SCANOUT -> FREE
+ * Queued buffers are flipped in FIFO order, so with N buffers the client can
+ * render up to N - 2 frames ahead of the one waiting for the next VBlank.
+ */
+class Swapchain {
+ public:
+  static const size_t kMinBuffers = 2;
+  static const size_t kMaxBuffers = 4;
+
+  enum class State {
+    FREE,
+    RENDERING,
+    QUEUED,
+    PENDING_FLIP,
+    SCANOUT,
+  };
+
+  // The buffer 0 starts as the scanout buffer, because the first mode setting
+  // needs something to show. GetScanoutBuffer() returns -1 after
+  // ReleaseScanoutBuffer() until the next DidFlip().
+  explicit Swapchain(size_t num_buffers);
+  ~Swapchain();
+  Swapchain(const Swapchain&) = delete;
+  void operator=(const Swapchain&) = delete;
+
+  size_t GetNumBuffers() const { return states_.size(); }
+  State GetState(int buffer) const { return states_[buffer]; }
+  int GetScanoutBuffer() const { return scanout_buffer_; }
+  size_t GetQueuedCount() const { return queued_buffers_.size(); }
+  bool HasFreeBuffer() const;
+  // The frames rendering, queued or waiting for the flip, which all reach
+  // the screen before the next one drawn.
+  size_t GetFramesAhead() const;
+
+  // Returns a free buffer and marks it as RENDERING, or -1 if every buffer is
+  // in use.
+  int AcquireBuffer();
+
+  // The client finished rendering |buffer|.
+  void QueueBuffer(int buffer);
+
+  // Returns the oldest queued buffer and marks it as PENDING_FLIP, or -1 if
+  // nothing is queued. Only one flip can be pending at a time.
+  int BeginFlip();
+
+  // The pending buffer is on the screen now. The previous scanout buffer
+  // becomes free, unless it was released already.
+  void DidFlip();
+
+  // Frees the scanout buffer while a flip is still pending. It's for the
+  // caller who can make the GPU wait until the display is done with the
+  // buffer, i.e. explicit fencing. Returns the released buffer, or -1.
+  int ReleaseScanoutBuffer();
+
+ private:
+  std::vector<State> states_;
+  std::deque<int> queued_buffers_;
+  int pending_buffer_ = -1;
+  int scanout_buffer_ = 0;
+};
+
+}  // namespace ged
+
+#endif  // GED_SWAPCHAIN_H_
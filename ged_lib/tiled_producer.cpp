@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tiled_producer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "worker_pool.h"
+
+namespace ged {
+
+namespace {
+
+// Not too many tiles per thread, or the scheduling shows up.
+const int kTilesPerThread = 4;
+
+}  // namespace
+
+// static
+std::unique_ptr<TiledProducer> TiledProducer::Create(size_t num_threads) {
+  std::unique_ptr<TiledProducer> producer(new TiledProducer());
+  if (producer->Initialize(num_threads))
+    return producer;
+  return nullptr;
+}
+
+TiledProducer::TiledProducer() {}
+
+TiledProducer::~TiledProducer() {}
+
+bool TiledProducer::Initialize(size_t num_threads) {
+  pool_ = WorkerPool::Create(num_threads);
+  return !!pool_;
+}
+
+size_t TiledProducer::GetNumThreads() const {
+  return pool_->GetNumThreads();
+}
+
+void TiledProducer::SetTileSize(int width, int height) {
+  tile_width_ = std::max(width, 0);
+  tile_height_ = std::max(height, 0);
+}
+
+bool TiledProducer::Produce(StreamTexture* texture,
+                            StreamTexture::Access access,
+                            const FillCallback& fill) {
+  int bytes_per_pixel = StreamTexture::GetBytesPerPixel(texture->GetFormat());
+  if (!bytes_per_pixel) {
+    fprintf(stderr, "unknown stream texture format.\n");
+    return false;
+  }
+  // The tiles cover the plane 0 only.
+  if (texture->GetPlaneCount() > 1) {
+    fprintf(stderr, "cannot tile a multi-planar stream texture.\n");
+    return false;
+  }
+  uint8_t* pixels = static_cast<uint8_t*>(texture->Map(access));
+  if (!pixels) {
+    fprintf(stderr, "failed to map the stream texture.\n");
+    return false;
+  }
+  StreamTexture::Dimension dimension = texture->GetDimension();
+
+  int tile_width = tile_width_ ? tile_width_ : dimension.width;
+  int tile_height = tile_height_;
+  if (!tile_height) {
+    int num_tiles = GetNumThreads() * kTilesPerThread;
+    tile_height = (dimension.height + num_tiles - 1) / num_tiles;
+  }
+  tile_width = std::max(1, std::min(tile_width, dimension.width));
+  tile_height = std::max(1, std::min(tile_height, dimension.height));
+
+  int columns = (dimension.width + tile_width - 1) / tile_width;
+  int rows = (dimension.height + tile_height - 1) / tile_height;
+  pool_->ParallelFor(columns * rows, [&](size_t index) {
+    Tile tile;
+    tile.x = (index % columns) * tile_width;
+    tile.y = (index / columns) * tile_height;
+    tile.width = std::min(tile_width, dimension.width - tile.x);
+    tile.height = std::min(tile_height, dimension.height - tile.y);
+    tile.stride = dimension.stride;
+    tile.pixels =
+        pixels + tile.y * dimension.stride + tile.x * bytes_per_pixel;
+    fill(tile);
+  });
+
+  texture->Unmap();
+  return true;
+}
+
+}  // namespace ged
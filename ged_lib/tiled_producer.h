@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_TILED_PRODUCER_H_
+#define GED_TILED_PRODUCER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "egl_drm_glue.h"
+
+namespace ged {
+
+class WorkerPool;
+
+/*
+ * TiledProducer fills a StreamTexture on a WorkerPool. It maps the texture,
+ * splits it into tiles, runs the fill callback for every tile in parallel and
+ * unmaps the texture when all of them are done. By default the tiles are
+ * full-width row bands, which keeps every write sequential in memory.
+ */
+class TiledProducer {
+ public:
+  struct Tile {
+    // the first pixel of the tile
+    uint8_t* pixels;
+    // where the tile is in the texture
+    int x;
+    int y;
+    int width;
+    int height;
+    // bytes from a row to the next
+    int stride;
+  };
+  // Called on any thread of the pool.
+  typedef std::function<void(const Tile& tile)> FillCallback;
+
+  // See WorkerPool::Create() for |num_threads|.
+  static std::unique_ptr<TiledProducer> Create(size_t num_threads);
+
+  ~TiledProducer();
+  TiledProducer(const TiledProducer&) = delete;
+  void operator=(const TiledProducer&) = delete;
+
+  size_t GetNumThreads() const;
+
+  // 0 |width| means full-width bands. 0 |height| gives each thread a few
+  // tiles, so that the threads even out.
+  void SetTileSize(int width, int height);
+
+  // Fails on multi-planar textures, e.g. DRM_FORMAT_NV12.
+  bool Produce(StreamTexture* texture,
+               StreamTexture::Access access,
+               const FillCallback& fill);
+
+ private:
+  TiledProducer();
+
+  bool Initialize(size_t num_threads);
+
+  std::unique_ptr<WorkerPool> pool_;
+  int tile_width_ = 0;
+  int tile_height_ = 0;
+};
+
+}  // namespace ged
+
+#endif  // GED_TILED_PRODUCER_H_
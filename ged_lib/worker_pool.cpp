@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "worker_pool.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ged {
+
+class WorkerPool::Impl {
+ public:
+  explicit Impl(size_t num_threads) {
+    // The workers inherit a mask blocking every signal, so that signals go
+    // to the threads that handle them, e.g. through EventLoop::AddSignal(),
+    // even if the pool is created first.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (size_t i = 1; i < num_threads; ++i)
+      workers_.emplace_back(&Impl::WorkerMain, this);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  }
+  Impl(const Impl&) = delete;
+  void operator=(const Impl&) = delete;
+
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& worker : workers_)
+      worker.join();
+  }
+
+  size_t GetNumThreads() const { return workers_.size() + 1; }
+
+  void ParallelFor(size_t count, const Task& task) {
+    if (workers_.empty() || count <= 1) {
+      for (size_t i = 0; i < count; ++i)
+        task(i);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      count_ = count;
+      next_ = 0;
+      busy_workers_ = workers_.size();
+      generation_++;
+    }
+    work_cv_.notify_all();
+
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return !busy_workers_; });
+    task_ = nullptr;
+  }
+
+ private:
+  void WorkerMain() {
+    uint64_t seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [this, seen_generation] {
+          return quit_ || generation_ != seen_generation;
+        });
+        if (quit_)
+          return;
+        seen_generation = generation_;
+      }
+
+      RunTasks();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!--busy_workers_)
+        done_cv_.notify_one();
+    }
+  }
+
+  // Every thread takes the next index until none is left, so a slow task
+  // doesn't hold the others back.
+  void RunTasks() {
+    size_t index;
+    while ((index = next_.fetch_add(1)) < count_)
+      (*task_)(index);
+  }
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  // Written under |mutex_| before |generation_| changes.
+  const Task* task_ = nullptr;
+  size_t count_ = 0;
+  std::atomic<size_t> next_{0};
+  uint64_t generation_ = 0;
+  size_t busy_workers_ = 0;
+  bool quit_ = false;
+};
+
+// static
+std::unique_ptr<WorkerPool> WorkerPool::Create(size_t num_threads) {
+  std::unique_ptr<WorkerPool> pool(new WorkerPool());
+  if (pool->Initialize(num_threads))
+    return pool;
+  return nullptr;
+}
+
+WorkerPool::WorkerPool() {}
+
+WorkerPool::~WorkerPool() {}
+
+bool WorkerPool::Initialize(size_t num_threads) {
+  if (!num_threads)
+    num_threads = std::thread::hardware_concurrency();
+  if (!num_threads)
+    num_threads = 1;
+  impl_.reset(new Impl(num_threads));
+  return true;
+}
+
+size_t WorkerPool::GetNumThreads() const {
+  return impl_->GetNumThreads();
+}
+
+void WorkerPool::ParallelFor(size_t count, const Task& task) {
+  impl_->ParallelFor(count, task);
+}
+
+}  // namespace ged
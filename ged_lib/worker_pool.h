@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_WORKER_POOL_H_
+#define GED_WORKER_POOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace ged {
+
+/*
+ * WorkerPool keeps threads alive between jobs, so that splitting per-frame
+ * work doesn't pay for thread creation every frame. The calling thread works
+ * too, so a pool of N threads spawns N - 1. The spawned threads block every
+ * signal.
+ */
+class WorkerPool {
+ public:
+  typedef std::function<void(size_t index)> Task;
+
+  // 0 |num_threads| means one per CPU core.
+  static std::unique_ptr<WorkerPool> Create(size_t num_threads);
+
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  void operator=(const WorkerPool&) = delete;
+
+  size_t GetNumThreads() const;
+
+  // Calls |task| for every index in [0, count) and returns when all calls are
+  // done. Only one thread can call it at a time.
+  void ParallelFor(size_t count, const Task& task);
+
+ private:
+  WorkerPool();
+
+  bool Initialize(size_t num_threads);
+
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ged
+
+#endif  // GED_WORKER_POOL_H_
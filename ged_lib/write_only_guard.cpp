@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "write_only_guard.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+namespace ged {
+
+namespace {
+
+const size_t kMaxGuards = 32;
+
+bool IsWriteFault(const ucontext_t* context) {
+#if defined(__x86_64__) || defined(__i386__)
+  // The page fault error code has this bit set for writes.
+  const greg_t kPageFaultWrite = 1 << 1;
+  return context->uc_mcontext.gregs[REG_ERR] & kPageFaultWrite;
+#else
+  return true;
+#endif
+}
+
+}  // namespace
+
+class WriteOnlyGuard::Impl {
+ public:
+  Impl(void* address, size_t size)
+      : begin_(reinterpret_cast<uintptr_t>(address)),
+        end_(begin_ + size),
+        page_size_(sysconf(_SC_PAGESIZE)) {}
+  Impl(const Impl&) = delete;
+  void operator=(const Impl&) = delete;
+
+  ~Impl() {
+    // Leave the handler first, so that it can't find a freed guard. A fault
+    // after this is no longer ours, hence the contract in the header.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& guard : guards_) {
+        if (guard.load() == this)
+          guard.store(nullptr);
+      }
+    }
+    Unprotect(nullptr);
+  }
+
+  bool Initialize() {
+    assert(!(begin_ & (page_size_ - 1)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!handler_installed_) {
+      struct sigaction action = {};
+      action.sa_sigaction = HandleFault;
+      action.sa_flags = SA_SIGINFO;
+      sigemptyset(&action.sa_mask);
+      if (sigaction(SIGSEGV, &action, &old_action_)) {
+        fprintf(stderr, "cannot handle SIGSEGV: %m\n");
+        return false;
+      }
+      handler_installed_ = true;
+    }
+    for (auto& guard : guards_) {
+      if (!guard.load()) {
+        guard.store(this);
+        return true;
+      }
+    }
+    fprintf(stderr, "too many WriteOnlyGuards.\n");
+    return false;
+  }
+
+  bool Protect() {
+    reads_ = 0;
+    if (mprotect(reinterpret_cast<void*>(begin_), end_ - begin_, PROT_NONE)) {
+      fprintf(stderr, "cannot protect the mapping: %m\n");
+      return false;
+    }
+    return true;
+  }
+
+  size_t Unprotect(size_t* first_read_offset) {
+    if (mprotect(reinterpret_cast<void*>(begin_), end_ - begin_,
+                 PROT_READ | PROT_WRITE)) {
+      fprintf(stderr, "cannot unprotect the mapping: %m\n");
+    }
+    if (first_read_offset)
+      *first_read_offset = first_read_offset_;
+    return reads_.exchange(0);
+  }
+
+ private:
+  // Runs in the signal handler.
+  bool OnFault(uintptr_t address, const ucontext_t* context) {
+    if (address < begin_ || address >= end_)
+      return false;
+    if (!IsWriteFault(context)) {
+      if (!reads_.fetch_add(1))
+        first_read_offset_ = address - begin_;
+    }
+    uintptr_t page = address & ~(page_size_ - 1);
+    return !mprotect(reinterpret_cast<void*>(page), page_size_,
+                     PROT_READ | PROT_WRITE);
+  }
+
+  static void HandleFault(int signo, siginfo_t* info, void* context) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(info->si_addr);
+    for (auto& slot : guards_) {
+      Impl* guard = slot.load();
+      if (guard &&
+          guard->OnFault(address, static_cast<const ucontext_t*>(context)))
+        return;
+    }
+
+    // Not ours, so pass it on.
+    if (old_action_.sa_flags & SA_SIGINFO) {
+      old_action_.sa_sigaction(signo, info, context);
+    } else if (old_action_.sa_handler != SIG_DFL &&
+               old_action_.sa_handler != SIG_IGN) {
+      old_action_.sa_handler(signo);
+    } else {
+      // Crash on the same fault again, without us.
+      signal(signo, SIG_DFL);
+    }
+  }
+
+  const uintptr_t begin_;
+  const uintptr_t end_;
+  const uintptr_t page_size_;
+  std::atomic<size_t> reads_{0};
+  size_t first_read_offset_ = 0;
+
+  // The handler is installed once and stays, and finds the guards here.
+  static std::mutex mutex_;
+  static bool handler_installed_;
+  static struct sigaction old_action_;
+  static std::atomic<Impl*> guards_[kMaxGuards];
+};
+
+std::mutex WriteOnlyGuard::Impl::mutex_;
+bool WriteOnlyGuard::Impl::handler_installed_ = false;
+struct sigaction WriteOnlyGuard::Impl::old_action_;
+std::atomic<WriteOnlyGuard::Impl*> WriteOnlyGuard::Impl::guards_[kMaxGuards];
+
+// static
+std::unique_ptr<WriteOnlyGuard> WriteOnlyGuard::Create(void* address,
+                                                       size_t size) {
+#if defined(__x86_64__) || defined(__i386__)
+  std::unique_ptr<WriteOnlyGuard> guard(new WriteOnlyGuard());
+  if (guard->Initialize(address, size))
+    return guard;
+#else
+  fprintf(stderr, "WriteOnlyGuard works only on x86.\n");
+#endif
+  return nullptr;
+}
+
+WriteOnlyGuard::WriteOnlyGuard() {}
+
+WriteOnlyGuard::~WriteOnlyGuard() {}
+
+bool WriteOnlyGuard::Initialize(void* address, size_t size) {
+  impl_.reset(new Impl(address, size));
+  return impl_->Initialize();
+}
+
+bool WriteOnlyGuard::Protect() {
+  return impl_->Protect();
+}
+
+size_t WriteOnlyGuard::Unprotect(size_t* first_read_offset) {
+  return impl_->Unprotect(first_read_offset);
+}
+
+}  // namespace ged
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2016 Dongseong Hwang <dongseong.hwang@intel.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GED_WRITE_ONLY_GUARD_H_
+#define GED_WRITE_ONLY_GUARD_H_
+
+#include <cstddef>
+#include <memory>
+
+namespace ged {
+
+/*
+ * WriteOnlyGuard is a debugging aid that catches reads from memory that
+ * should only be written, e.g. a write-combined dma-buf mapping, where every
+ * read stalls on uncached memory.
+ *
+ * Protect() takes away the access to the range, so that the first access to
+ * each page faults. A write opens the page, and a read is counted before
+ * opening it. So it catches loops that load, modify and store, but neither
+ * reading back a page that was already written nor a single instruction that
+ * both reads and writes memory. It only works where the fault tells a read
+ * from a write, i.e. x86.
+ */
+class WriteOnlyGuard {
+ public:
+  // |address| is page aligned. Returns nullptr if the CPU isn't supported.
+  static std::unique_ptr<WriteOnlyGuard> Create(void* address, size_t size);
+
+  // Must not run while another thread may still touch the range, because its
+  // fault would no longer be caught and would crash.
+  ~WriteOnlyGuard();
+  WriteOnlyGuard(const WriteOnlyGuard&) = delete;
+  void operator=(const WriteOnlyGuard&) = delete;
+
+  bool Protect();
+  // Gives the full access back, and returns how many pages were read first
+  // since Protect(). |first_read_offset| is set to where the first one was.
+  size_t Unprotect(size_t* first_read_offset);
+
+ private:
+  WriteOnlyGuard();
+
+  bool Initialize(void* address, size_t size);
+
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ged
+
+#endif  // GED_WRITE_ONLY_GUARD_H_